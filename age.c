@@ -0,0 +1,76 @@
+// Page aging sampler, for the policies that age pages (NFUA, LAPA
+// and AQ, see policy.c).
+//
+// Every AGE_PERIOD timer ticks of its own, each CPU ages the pages of
+// the process it is running, if the tick interrupted it in user mode.
+// That process is then in no kernel path that changes its page
+// details, and other CPUs only change the page details of processes
+// that are not running (kswapd holds them off the CPUs first), so no
+// lock is taken.  The policy's tick hook does the work: NFUA and LAPA
+// shift each resident page's aging counter right and put PTE_A in at
+// the top; AQ moves pages referenced since the last sample ahead of
+// unreferenced ones.  The CPU's TLB is flushed afterwards, so that the
+// next reference to a page sets PTE_A again.  A process is thus aged
+// for the time it runs; a tick that finds it in the kernel leaves the
+// sample to the next one.
+//
+// The PTE of each resident page is cached in its page details, so a
+// sample costs no page table walks.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "pgstat.h"
+
+#ifndef NONE
+// Timer tick on this CPU; user is set if it interrupted user code.
+void
+agetick(int user)
+{
+  struct cpu *c = mycpu();
+  struct proc *p = c->proc;
+  unsigned long long start;
+
+  if(++c->ageticks < AGE_PERIOD || p == 0 || p->pdt == 0 || p->policy->tick == 0)
+    return;
+  if(!user){
+    c->agedeferred++;
+    return;
+  }
+  c->ageticks = 0;
+  start = rdtsc();
+  p->policy->tick(p);
+  lcr3(V2P(p->pgdir));
+  c->agecycles += rdtsc() - start;
+  c->agesamples++;
+  c->agepages += p->pim;
+  p->aged++;
+}
+#endif
+
+// Fill in the sampler's counters, summed over the CPUs.  Returns -1
+// without paging.
+int
+agestat(struct agestat *st)
+{
+#ifndef NONE
+  unsigned long long cycles = 0;
+  int i;
+
+  memset(st, 0, sizeof(*st));
+  for(i = 0; i < ncpu; i++){
+    st->samples += cpus[i].agesamples;
+    st->pages += cpus[i].agepages;
+    st->deferred += cpus[i].agedeferred;
+    cycles += cpus[i].agecycles;
+  }
+  st->kcycles = cycles >> 10;
+  return 0;
+#else
+  return -1;
+#endif
+}
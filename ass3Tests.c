@@ -2,9 +2,1054 @@
 #include "stat.h"
 #include "user.h"
 #include "syscall.h"
+#include "pgstat.h"
+#include "fcntl.h"
+#include "mman.h"
+
+#define PAGESIZE 4096
+
+// Benchmarks, run as "ass3Tests <name>".  Build the kernel with the
+// different Makefile options (e.g. FORK=COW / FORK=EAGER,
+// SELECTION=SCFIFO / SELECTION=GCLOCK) and compare.  Where a
+// benchmark relies on the kernel behaving a certain way it checks it,
+// and the run ends with the number of checks that failed.
+
+int failures;
+
+// Report and count a check of benchmark name that did not hold.
+void check(char *name, int ok, char *what) {
+  if(!ok) {
+    printf(1, "%s: FAILED: %s\n", name, what);
+    failures++;
+  }
+}
+
+// Touch the first byte of each of the n pages at heap, rounds times:
+// add one to it if write, else just read it.  Leaves in *d what that
+// cost: the counters of pgstat (ts, pf, cd, df, sh, ra, rw, gh) after
+// minus before, the rest as they are after.  Returns the ticks taken.
+int touchPages(char *heap, int n, int rounds, int write, struct pgstat *d) {
+  volatile char *h = heap;
+  struct pgstat before;
+  int j, r, start;
+
+  pgstat(&before);
+  start = uptime();
+  for(r = 0; r < rounds; r++)
+    for(j = 0; j < n; j++) {
+      if(write)
+        h[j * PAGESIZE]++;
+      else
+        (void)h[j * PAGESIZE];
+    }
+  start = uptime() - start;
+  pgstat(d);
+  d->ts -= before.ts;
+  d->pf -= before.pf;
+  d->cd -= before.cd;
+  d->df -= before.df;
+  d->sh -= before.sh;
+  d->ra -= before.ra;
+  d->rw -= before.rw;
+  d->gh -= before.gh;
+  return start;
+}
+
+#define FORK_ROUNDS 20
+#define FORK_PAGES 24
+
+// Fork latency with a partly swapped out heap: children that exit at
+// once (the fork+exec case) and children that write every page.
+void forkBench(void) {
+  int i, j, start, quick, dirty;
+  char *heap = sbrk(FORK_PAGES * PAGESIZE);
+
+  for(i = 0; i < FORK_PAGES; i++)
+    heap[i * PAGESIZE] = i;
+
+  start = uptime();
+  for(i = 0; i < FORK_ROUNDS; i++) {
+    if(fork() == 0)
+      exit();
+    wait();
+  }
+  quick = uptime() - start;
+
+  start = uptime();
+  for(i = 0; i < FORK_ROUNDS; i++) {
+    if(fork() == 0) {
+      for(j = 0; j < FORK_PAGES; j++)
+        heap[j * PAGESIZE]++;
+      exit();
+    }
+    wait();
+  }
+  dirty = uptime() - start;
+
+  printf(1, "fork: %d forks, %d heap pages: %d ticks exit-only, %d ticks write-all\n",
+    FORK_ROUNDS, FORK_PAGES, quick, dirty);
+  sbrk(-FORK_PAGES * PAGESIZE);
+}
+
+#define COW_PAGES 24
+#define COW_RESIDENT 12
+
+// Copy-on-write fork correctness.  Half the heap is swapped out at
+// fork, so parent and child share swap slots as well as frames.  The
+// child must read the parent's values, then overwrite every page and
+// read its own back; the parent must still read its own values.
+void cowTest(void) {
+  struct pgstat ps, st;
+  int i, bad, paging, fds[2];
+  int *heap;
+
+  pgstat(&ps);
+  paging = setpglimit(COW_RESIDENT, 0) == 0;    // not with SELECTION=NONE
+  heap = (int*)sbrk(COW_PAGES * PAGESIZE);
+  for(i = 0; i < COW_PAGES; i++)
+    heap[i * PAGESIZE / sizeof(int)] = 1000 + i;
+  pgstat(&st);
+  check("cow", !paging || st.sp > 0, "no heap page swapped out at fork");
+
+  pipe(fds);
+  if(fork() == 0) {
+    close(fds[0]);
+    for(bad = i = 0; i < COW_PAGES; i++) {
+      bad += heap[i * PAGESIZE / sizeof(int)] != 1000 + i;
+      heap[i * PAGESIZE / sizeof(int)] = 2000 + i;
+    }
+    for(i = 0; i < COW_PAGES; i++)
+      bad += heap[i * PAGESIZE / sizeof(int)] != 2000 + i;
+    write(fds[1], &bad, sizeof(bad));
+    exit();
+  }
+  close(fds[1]);
+  if(read(fds[0], &bad, sizeof(bad)) != sizeof(bad))
+    bad = -1;
+  close(fds[0]);
+  wait();
+  check("cow", bad == 0, "child read wrong values");
+  for(bad = i = 0; i < COW_PAGES; i++)
+    bad += heap[i * PAGESIZE / sizeof(int)] != 1000 + i;
+  check("cow", bad == 0, "parent's values changed by the child's writes");
+  printf(1, "cow: %d pages, %d swapped at fork, child wrote all: %d parent pages wrong\n",
+    COW_PAGES, st.sp, bad);
+  sbrk(-COW_PAGES * PAGESIZE);
+  setpglimit(ps.maxpim, ps.maxsp);
+}
+
+#define PIPE_PAGES 16
+#define PIPE_RESIDENT 8
+#define PIPE_ROUNDS 4
+#define PIPE_BYTES 2048
+
+// A reader asleep in read() on a pipe, into a buffer paged out by its
+// own faults before it slept (and maybe by the reclaim thread while it
+// slept), must get what is written to the pipe: the kernel faults the
+// buffer back in outside the pipe's lock.  The writer's buffer is
+// paged out before each write too.
+void pipeTest(void) {
+  struct pgstat ps;
+  int i, j, r, n, bad, fds[2], res[2];
+  char *heap, *buf;
+
+  pgstat(&ps);
+  setpglimit(PIPE_RESIDENT, 0);
+  heap = sbrk(PIPE_PAGES * PAGESIZE);
+  pipe(fds);
+  pipe(res);
+  if(fork() == 0) {
+    close(fds[1]);
+    close(res[0]);
+    for(bad = r = 0; r < PIPE_ROUNDS; r++) {
+      buf = heap + r * PAGESIZE;
+      for(j = 0; j < PIPE_PAGES; j++)
+        heap[((r + j) % PIPE_PAGES) * PAGESIZE] = 0;
+      for(n = 0; n < PIPE_BYTES; n += i)
+        if((i = read(fds[0], buf + n, PIPE_BYTES - n)) <= 0)
+          break;
+      for(j = 0; j < PIPE_BYTES; j++)
+        bad += buf[j] != (char)(r + j);
+    }
+    write(res[1], &bad, sizeof(bad));
+    exit();
+  }
+  close(fds[0]);
+  close(res[1]);
+  for(r = 0; r < PIPE_ROUNDS; r++) {
+    n = PIPE_PAGES - 1 - r;
+    buf = heap + n * PAGESIZE;
+    for(j = 0; j < PIPE_BYTES; j++)
+      buf[j] = r + j;
+    for(j = 1; j < PIPE_PAGES; j++)
+      heap[((n + j) % PIPE_PAGES) * PAGESIZE] = 0;
+    sleep(2);           // let the reader fall asleep in read()
+    write(fds[1], buf, PIPE_BYTES);
+  }
+  close(fds[1]);
+  if(read(res[0], &bad, sizeof(bad)) != sizeof(bad))
+    bad = -1;
+  close(res[0]);
+  wait();
+  check("pipe", bad == 0, "reader got wrong data");
+  printf(1, "pipe: %d writes of %d bytes to a sleeping reader, buffers paged out: %d bytes wrong\n",
+    PIPE_ROUNDS, PIPE_BYTES, bad);
+  sbrk(-PIPE_PAGES * PAGESIZE);
+  setpglimit(ps.maxpim, ps.maxsp);
+}
+
+#define FAULT_ROUNDS 20
+#define LIMIT_PAGES 12
+
+// Page fault path cost as the number of tracked pages grows: walk a
+// heap larger than the resident set cyclically so every touch faults.
+void faultBench(void) {
+  static int sizes[] = {8, 12, 16, 20, 24};
+  struct pgstat d;
+  int i, j, ticks;
+  char *heap;
+
+  for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    heap = sbrk(sizes[i] * PAGESIZE);
+    for(j = 0; j < sizes[i]; j++)
+      heap[j * PAGESIZE] = j;
+    ticks = touchPages(heap, sizes[i], FAULT_ROUNDS, 1, &d);
+    printf(1, "fault: %d heap pages, %d swapped: %d faults in %d ticks\n",
+      sizes[i], d.sp, d.pf, ticks);
+    sbrk(-sizes[i] * PAGESIZE);
+  }
+}
+
+// Touch the same heap under shrinking resident page limits.  Under
+// the first the heap fits with room to spare, so it must not fault.
+void limitBench(void) {
+  static int limits[] = {24, 16, 10, 6};
+  struct pgstat d;
+  int i, j, ticks;
+  char *heap;
+
+  heap = sbrk(LIMIT_PAGES * PAGESIZE);
+  for(j = 0; j < LIMIT_PAGES; j++)
+    heap[j * PAGESIZE] = j;
+  for(i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+    if(setpglimit(limits[i], 0) < 0) {
+      printf(1, "limit: setpglimit(%d) failed\n", limits[i]);
+      continue;
+    }
+    ticks = touchPages(heap, LIMIT_PAGES, FAULT_ROUNDS, 1, &d);
+    printf(1, "limit: %d resident, %d swapped: %d faults in %d ticks\n",
+      d.maxpim, d.sp, d.pf, ticks);
+    check("limit", limits[i] < 2 * LIMIT_PAGES || d.pf == 0,
+      "faults with the heap well within the limit");
+  }
+  sbrk(-LIMIT_PAGES * PAGESIZE);
+}
+
+#define SWAPIO_PAGES 16
+#define SWAPIO_RESIDENT 6
+
+// Cost of swap I/O: walk a heap under a small resident limit so that
+// every touch swaps a page in and another out, and report the disk
+// requests and ticks each swapped page costs.
+void swapioBench(void) {
+  struct pgstat ps;
+  struct swapstat before, after;
+  int j, r, pages, ticks, paging;
+  char *heap;
+
+  pgstat(&ps);
+  paging = setpglimit(SWAPIO_RESIDENT, 0) == 0;
+  heap = sbrk(SWAPIO_PAGES * PAGESIZE);
+  for(j = 0; j < SWAPIO_PAGES; j++)
+    heap[j * PAGESIZE] = j;
+  swapstat(&before);
+  for(r = 0; r < FAULT_ROUNDS; r++)
+    for(j = 0; j < SWAPIO_PAGES; j++)
+      heap[j * PAGESIZE]++;
+  swapstat(&after);
+  pages = (after.outs - before.outs) + (after.ins - before.ins);
+  ticks = after.ticks - before.ticks;
+  printf(1, "swapio: %d out, %d in: %d ide requests, %d sectors, %d ticks",
+    after.outs - before.outs, after.ins - before.ins,
+    after.idereqs - before.idereqs, after.idesecs - before.idesecs, ticks);
+  if(pages > 0)
+    printf(1, " (%d requests per page, %d ticks per 100 pages)",
+      (after.idereqs - before.idereqs) / pages, ticks * 100 / pages);
+  printf(1, "\n");
+  check("swapio", !paging || (after.outs > before.outs && after.ins > before.ins),
+    "no swap I/O with the heap past the limit");
+  sbrk(-SWAPIO_PAGES * PAGESIZE);
+  setpglimit(ps.maxpim, ps.maxsp);
+}
+
+#define SCAN_PAGES 32
+#define SCAN_RESIDENT 16
+#define SCAN_ROUNDS 5
+
+// Sequential scan of a heap twice the resident limit.  Without swap
+// readahead every page faults on every pass; with it the faults must
+// fall as the readahead window grows.
+void scanBench(void) {
+  struct pgstat ps, d;
+  int j, r, bad, paging, faults[SCAN_ROUNDS];
+  char *heap;
+
+  pgstat(&ps);
+  paging = setpglimit(SCAN_RESIDENT, 2 * SCAN_PAGES) == 0;
+  heap = sbrk(SCAN_PAGES * PAGESIZE);
+  for(j = 0; j < SCAN_PAGES; j++)
+    heap[j * PAGESIZE] = j;
+  for(r = 0; r < SCAN_ROUNDS; r++) {
+    touchPages(heap, SCAN_PAGES, 1, 0, &d);
+    faults[r] = d.pf;
+    printf(1, "scan: pass %d over %d pages, %d resident: %d faults, %d read ahead, %d unused\n",
+      r, SCAN_PAGES, d.maxpim, d.pf, d.ra, d.rw);
+  }
+  for(bad = j = 0; j < SCAN_PAGES; j++)
+    bad += heap[j * PAGESIZE] != j;
+  check("scan", bad == 0, "pages read back wrong");
+  check("scan", !paging || faults[SCAN_ROUNDS - 1] < faults[0],
+    "readahead did not lower the faults");
+  sbrk(-SCAN_PAGES * PAGESIZE);
+  setpglimit(ps.maxpim, ps.maxsp);
+}
+
+#define BCACHE_PROCS 4
+#define BCACHE_BLOCKS 40
+#define BCACHE_ROUNDS 4
+
+// stressfs in parallel: each child writes a file, then reads it back a
+// few times, while the buffer cache counters are watched.  Rebuild
+// with NBUF=n to compare cache sizes.
+void bcacheBench(void) {
+  static char data[512];
+  struct bcstat before, after;
+  char path[] = "bcache0";
+  int i, r, fd, start, ticks;
+
+  bcstat(&before);
+  start = uptime();
+  for(i = 0; i < BCACHE_PROCS; i++) {
+    if(fork() == 0) {
+      path[6] += i;
+      memset(data, 'a' + i, sizeof(data));
+      fd = open(path, O_CREATE | O_RDWR);
+      for(r = 0; r < BCACHE_BLOCKS; r++)
+        write(fd, data, sizeof(data));
+      close(fd);
+      for(r = 0; r < BCACHE_ROUNDS; r++) {
+        fd = open(path, O_RDONLY);
+        while(read(fd, data, sizeof(data)) == sizeof(data))
+          ;
+        close(fd);
+      }
+      unlink(path);
+      exit();
+    }
+  }
+  for(i = 0; i < BCACHE_PROCS; i++)
+    wait();
+  ticks = uptime() - start;
+  bcstat(&after);
+  r = (after.hits - before.hits) + (after.misses - before.misses);
+  printf(1, "bcache: %d procs, %d buffers: %d lookups, %d%% hits, %d contended, %d ticks\n",
+    BCACHE_PROCS, after.nbuf, r, r ? (after.hits - before.hits) * 100 / r : 0,
+    after.contended - before.contended, ticks);
+}
+
+#define ALLOC_PROCS 4
+#define ALLOC_ROUNDS 2000
+
+// kalloc()/kfree() from several CPUs at once: each child creates and
+// closes pipes, which allocate and free one page each, outside the
+// paging lock.  Run with CPUS=n to compare.
+void allocBench(void) {
+  int i, r, fds[2], start, ticks, allocs;
+
+  start = uptime();
+  for(i = 0; i < ALLOC_PROCS; i++) {
+    if(fork() == 0) {
+      for(r = 0; r < ALLOC_ROUNDS; r++) {
+        if(pipe(fds) < 0) {
+          printf(1, "alloc: pipe failed\n");
+          exit();
+        }
+        close(fds[0]);
+        close(fds[1]);
+      }
+      exit();
+    }
+  }
+  for(i = 0; i < ALLOC_PROCS; i++)
+    wait();
+  ticks = uptime() - start;
+  allocs = ALLOC_PROCS * ALLOC_ROUNDS;
+  printf(1, "alloc: %d procs, %d page allocations in %d ticks", ALLOC_PROCS, allocs, ticks);
+  if(ticks > 0)
+    printf(1, " (%d per tick)", allocs / ticks);
+  printf(1, "\n");
+}
+
+#define SBRK_PAGES 8
+#define SBRK_ROUNDS 500
+
+// Grow the heap within the resident limit, touch every new page and
+// shrink it again, so the cost is allocating zeroed frames.  Build
+// with BUILD=DEBUG to compare with freed pages being filled with junk.
+void sbrkBench(void) {
+  struct pgstat ps;
+  int j, r, start, ticks, pages;
+  char *heap;
+
+  pgstat(&ps);
+  if(ps.pim + SBRK_PAGES > ps.maxpim)
+    setpglimit(ps.pim + SBRK_PAGES, 0);
+  start = uptime();
+  for(r = 0; r < SBRK_ROUNDS; r++) {
+    if((heap = sbrk(SBRK_PAGES * PAGESIZE)) == (char*)-1) {
+      printf(1, "sbrk: sbrk failed\n");
+      break;
+    }
+    for(j = 0; j < SBRK_PAGES; j++)
+      heap[j * PAGESIZE] = j;
+    sbrk(-SBRK_PAGES * PAGESIZE);
+  }
+  ticks = uptime() - start;
+  pages = r * SBRK_PAGES;
+  printf(1, "sbrk: %d pages allocated in %d ticks", pages, ticks);
+  if(ticks > 0)
+    printf(1, " (%d per tick)", pages / ticks);
+  printf(1, "\n");
+  setpglimit(ps.maxpim, ps.maxsp);
+}
+
+#define LAZY_PAGES 32
+#define LAZY_TOUCH 4
+
+// Grow the heap far past the resident limit but touch only a few
+// pages: with demand-zero sbrk nothing should be swapped out.
+void lazyBench(void) {
+  struct pgstat before, after;
+  int j, start, ticks;
+  char *heap;
+
+  pgstat(&before);
+  start = uptime();
+  heap = sbrk(LAZY_PAGES * PAGESIZE);
+  if(heap == (char*)-1) {
+    printf(1, "lazy: sbrk failed\n");
+    return;
+  }
+  for(j = 0; j < LAZY_TOUCH; j++)
+    heap[j * (LAZY_PAGES / LAZY_TOUCH) * PAGESIZE] = j;
+  ticks = uptime() - start;
+  pgstat(&after);
+  printf(1, "lazy: %d pages grown, %d touched: %d more resident, %d paged out, %d ticks\n",
+    LAZY_PAGES, LAZY_TOUCH, after.pim - before.pim, after.ts - before.ts, ticks);
+  check("lazy", after.ts == before.ts, "pages swapped out growing the heap");
+  check("lazy", after.pim - before.pim <= LAZY_TOUCH, "untouched pages made resident");
+  sbrk(-LAZY_PAGES * PAGESIZE);
+}
+
+#define EXEC_ROUNDS 10
+
+// Exec latency: fork and exec "ass3Tests startup", which exits at
+// once, EXEC_ROUNDS times; then once more with the child reporting how
+// many pages it had to fault in to get to main.
+void execBench(void) {
+  char *argv[] = {"ass3Tests", "startup", "quiet", 0};
+  int i, start, ticks;
+
+  start = uptime();
+  for(i = 0; i < EXEC_ROUNDS; i++) {
+    if(fork() == 0) {
+      exec(argv[0], argv);
+      printf(1, "exec: exec failed\n");
+      exit();
+    }
+    wait();
+  }
+  ticks = uptime() - start;
+  printf(1, "exec: %d fork+exec in %d ticks\n", EXEC_ROUNDS, ticks);
+  argv[2] = 0;
+  if(fork() == 0) {
+    exec(argv[0], argv);
+    exit();
+  }
+  wait();
+}
+
+// Run as "ass3Tests startup" by execBench.
+void startup(int quiet) {
+  struct pgstat ps;
+
+  pgstat(&ps);
+  if(!quiet)
+    printf(1, "exec: at main %d pages resident, %d faulted in (%d shared), %d swapped\n",
+      ps.pim, ps.df, ps.sh, ps.ts);
+  exit();
+}
+
+#define THRASH_IDLE 3
+#define THRASH_IDLE_PAGES 12
+#define THRASH_HOT_PAGES 24
+#define THRASH_ROUNDS 20
+
+// One hot process walks its heap while idle processes sit on memory
+// they touched once.  Per-process policies can only evict the hot
+// process's own pages; GCLOCK can take the idle processes' frames.
+void thrashBench(void) {
+  int i, j, ticks, pids[THRASH_IDLE], fds[2];
+  struct pgstat d;
+  char *heap, c;
+
+  pipe(fds);
+  for(i = 0; i < THRASH_IDLE; i++) {
+    if((pids[i] = fork()) == 0) {
+      close(fds[0]);
+      heap = sbrk(THRASH_IDLE_PAGES * PAGESIZE);
+      for(j = 0; j < THRASH_IDLE_PAGES; j++)
+        heap[j * PAGESIZE] = j;
+      write(fds[1], "x", 1);
+      for(;;)
+        sleep(100);
+    }
+  }
+  close(fds[1]);
+  for(i = 0; i < THRASH_IDLE; i++)
+    read(fds[0], &c, 1);
+  close(fds[0]);
+
+  heap = sbrk(THRASH_HOT_PAGES * PAGESIZE);
+  for(j = 0; j < THRASH_HOT_PAGES; j++)
+    heap[j * PAGESIZE] = j;
+  ticks = touchPages(heap, THRASH_HOT_PAGES, THRASH_ROUNDS, 1, &d);
+  printf(1, "thrash: %d idle x %d pages, hot %d pages: %d faults in %d ticks\n",
+    THRASH_IDLE, THRASH_IDLE_PAGES, THRASH_HOT_PAGES, d.pf, ticks);
+
+  for(i = 0; i < THRASH_IDLE; i++)
+    kill(pids[i]);
+  for(i = 0; i < THRASH_IDLE; i++)
+    wait();
+  sbrk(-THRASH_HOT_PAGES * PAGESIZE);
+}
+
+#define MMAP_PAGES 24
+#define MMAP_ROUNDS 3
+
+// Scan a file larger than the resident limit MMAP_ROUNDS times: read()
+// into a heap buffer, whose pages must be written to swap when they
+// are evicted, against a private mapping, whose clean pages are just
+// dropped and read from the file again.  Then check that a shared
+// mapping is shared with a fork child and its writes reach the file,
+// and that an anonymous one is zeroed.
+void mmapBench(void) {
+  static char data[PAGESIZE];
+  struct pgstat ps, before, after;
+  int i, r, fd, start, sum, want, paging;
+  char *buf, *map;
+
+  pgstat(&ps);
+  paging = setpglimit(0, 2 * MMAP_PAGES) == 0;
+
+  fd = open("mmapfile", O_CREATE | O_RDWR);
+  for(i = 0; i < MMAP_PAGES; i++) {
+    memset(data, i, sizeof(data));
+    write(fd, data, sizeof(data));
+  }
+  close(fd);
+  want = MMAP_ROUNDS * (MMAP_PAGES - 1) * MMAP_PAGES / 2;
+
+  pgstat(&before);
+  start = uptime();
+  buf = sbrk(MMAP_PAGES * PAGESIZE);
+  for(sum = r = 0; r < MMAP_ROUNDS; r++) {
+    fd = open("mmapfile", O_RDONLY);
+    for(i = 0; i < MMAP_PAGES; i++)
+      read(fd, buf + i * PAGESIZE, PAGESIZE);
+    close(fd);
+    for(i = 0; i < MMAP_PAGES; i++)
+      sum += buf[i * PAGESIZE];
+  }
+  sbrk(-MMAP_PAGES * PAGESIZE);
+  pgstat(&after);
+  printf(1, "mmap: read() %d pages %d times: %d ticks, %d swapped out, %d dropped\n",
+    MMAP_PAGES, MMAP_ROUNDS, uptime() - start, after.ts - before.ts, after.cd - before.cd);
+  check("mmap", sum == want, "read() got wrong data");
+
+  pgstat(&before);
+  start = uptime();
+  fd = open("mmapfile", O_RDONLY);
+  map = mmap(0, MMAP_PAGES * PAGESIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == (char*)-1) {
+    printf(1, "mmap: mmap failed\n");
+    unlink("mmapfile");
+    setpglimit(ps.maxpim, ps.maxsp);
+    return;
+  }
+  for(sum = r = 0; r < MMAP_ROUNDS; r++)
+    for(i = 0; i < MMAP_PAGES; i++)
+      sum += map[i * PAGESIZE];
+  munmap(map, MMAP_PAGES * PAGESIZE);
+  pgstat(&after);
+  printf(1, "mmap: mapped %d pages %d times: %d ticks, %d swapped out, %d dropped\n",
+    MMAP_PAGES, MMAP_ROUNDS, uptime() - start, after.ts - before.ts, after.cd - before.cd);
+  check("mmap", sum == want, "mapped pages read wrong");
+  check("mmap", after.ts == before.ts, "clean mapped pages written to swap");
+  check("mmap", !paging || after.cd > before.cd, "no clean mapped page dropped");
+
+  fd = open("mmapfile", O_RDWR);
+  map = mmap(0, PAGESIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, PAGESIZE);
+  close(fd);
+  if(map == (char*)-1) {
+    check("mmap", 0, "shared mmap failed");
+    unlink("mmapfile");
+    setpglimit(ps.maxpim, ps.maxsp);
+    return;
+  }
+  map[7] = 'x';
+  if(fork() == 0) {
+    map[9] = map[7] == 'x' ? 'y' : 'n';
+    exit();
+  }
+  wait();
+  check("mmap", map[9] == 'y', "shared mapping not shared with a fork child");
+  munmap(map, PAGESIZE);
+  fd = open("mmapfile", O_RDONLY);
+  read(fd, data, sizeof(data));
+  read(fd, data, sizeof(data));
+  close(fd);
+  map = mmap(0, PAGESIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(map == (char*)-1) {
+    check("mmap", 0, "anonymous mmap failed");
+    unlink("mmapfile");
+    setpglimit(ps.maxpim, ps.maxsp);
+    return;
+  }
+  printf(1, "mmap: shared write %s, anonymous page %s\n",
+    data[7] == 'x' && data[9] == 'y' && data[8] == 1 ? "ok" : "lost",
+    map[0] == 0 ? "zeroed" : "not zeroed");
+  check("mmap", data[7] == 'x' && data[9] == 'y' && data[8] == 1,
+    "shared writes did not reach the file");
+  check("mmap", map[0] == 0, "anonymous page not zeroed");
+  munmap(map, PAGESIZE);
+  unlink("mmapfile");
+  setpglimit(ps.maxpim, ps.maxsp);
+}
+
+#define ADVISE_RESIDENT 12
+#define ADVISE_HOT 4
+#define ADVISE_SCAN 20
+#define ADVISE_ROUNDS 2
+
+// A few hot pages touched between the pages of a scan larger than the
+// resident limit, once without advice and once with the scan advised
+// MADV_SEQUENTIAL, which should keep the policy from evicting the hot
+// pages.  Then MADV_WILLNEED before a scan, and MADV_DONTNEED.
+void adviseBench(void) {
+  struct pgstat ps, before, after;
+  int i, j, r, pass, paging, faults[2];
+  char *heap, *scan;
+
+  pgstat(&ps);
+  paging = setpglimit(ADVISE_RESIDENT, 2 * (ADVISE_HOT + ADVISE_SCAN)) == 0;
+  heap = sbrk((ADVISE_HOT + ADVISE_SCAN) * PAGESIZE);
+  scan = heap + ADVISE_HOT * PAGESIZE;
+  for(i = 0; i < ADVISE_HOT + ADVISE_SCAN; i++)
+    heap[i * PAGESIZE] = i;
+  for(pass = 0; pass < 2; pass++) {
+    madvise(scan, ADVISE_SCAN * PAGESIZE, pass ? MADV_SEQUENTIAL : MADV_NORMAL);
+    pgstat(&before);
+    for(r = 0; r < ADVISE_ROUNDS; r++)
+      for(j = 0; j < ADVISE_SCAN; j++) {
+        scan[j * PAGESIZE]++;
+        for(i = 0; i < ADVISE_HOT; i++)
+          heap[i * PAGESIZE]++;
+      }
+    pgstat(&after);
+    faults[pass] = after.pf - before.pf;
+  }
+  printf(1, "advise: %d hot pages, %d page scan, %d resident: %d faults normal, %d sequential\n",
+    ADVISE_HOT, ADVISE_SCAN, ADVISE_RESIDENT, faults[0], faults[1]);
+  check("advise", !paging || faults[1] < faults[0], "MADV_SEQUENTIAL did not spare the hot pages");
+
+  madvise(scan, ADVISE_SCAN * PAGESIZE, MADV_NORMAL);
+  pgstat(&before);
+  madvise(scan + (ADVISE_SCAN - ADVISE_RESIDENT / 2) * PAGESIZE,
+    ADVISE_RESIDENT / 2 * PAGESIZE, MADV_WILLNEED);
+  for(j = ADVISE_SCAN - ADVISE_RESIDENT / 2; j < ADVISE_SCAN; j++)
+    scan[j * PAGESIZE]++;
+  pgstat(&after);
+  printf(1, "advise: willneed on %d pages, %d faults using them\n",
+    ADVISE_RESIDENT / 2, after.pf - before.pf);
+
+  pgstat(&before);
+  madvise(scan, ADVISE_SCAN * PAGESIZE, MADV_DONTNEED);
+  pgstat(&after);
+  printf(1, "advise: dontneed on %d pages: %d resident, %d swapped before, %d, %d after, %s\n",
+    ADVISE_SCAN, before.pim, before.sp, after.pim, after.sp,
+    scan[0] == 0 && scan[(ADVISE_SCAN - 1) * PAGESIZE] == 0 ? "zeroed" : "not zeroed");
+  check("advise", scan[0] == 0 && scan[(ADVISE_SCAN - 1) * PAGESIZE] == 0,
+    "MADV_DONTNEED pages not zeroed");
+  check("advise", !paging || after.pim + after.sp < before.pim + before.sp,
+    "MADV_DONTNEED freed nothing");
+  sbrk(-(ADVISE_HOT + ADVISE_SCAN) * PAGESIZE);
+  setpglimit(ps.maxpim, ps.maxsp);
+}
+
+#define PFF_HOT 20
+#define PFF_IDLE 12
+#define PFF_ROUNDS 6
+#define PFF_ROUND_TICKS 20
+
+// Page fault frequency control (LIMIT=PFF): a process cycling over more
+// pages than its starting resident limit should see the limit grow and
+// its faults fall off, while an idle child's limit shrinks.
+void pffBench(void) {
+  struct pgstat ps, before, after;
+  int i, r, start, first, fds[2], limits[2];
+  char *heap;
+
+  pipe(fds);
+  if(fork() == 0) {
+    close(fds[0]);
+    pgstat(&ps);
+    limits[0] = ps.maxpim;
+    heap = sbrk(PFF_IDLE * PAGESIZE);
+    for(i = 0; i < PFF_IDLE; i++)
+      heap[i * PAGESIZE] = i;
+    sleep(PFF_ROUNDS * PFF_ROUND_TICKS);
+    pgstat(&ps);
+    limits[1] = ps.maxpim;
+    write(fds[1], limits, sizeof(limits));
+    exit();
+  }
+  close(fds[1]);
+
+  heap = sbrk(PFF_HOT * PAGESIZE);
+  pgstat(&ps);
+  first = ps.maxpim;
+  for(r = 0; r < PFF_ROUNDS; r++) {
+    pgstat(&before);
+    start = uptime();
+    while(uptime() - start < PFF_ROUND_TICKS)
+      for(i = 0; i < PFF_HOT; i++)
+        heap[i * PAGESIZE]++;
+    pgstat(&after);
+    printf(1, "pff: round %d over %d pages: limit %d -> %d, %d faults\n",
+      r, PFF_HOT, before.maxpim, after.maxpim, after.pf - before.pf);
+  }
+  sbrk(-PFF_HOT * PAGESIZE);
+  read(fds[0], limits, sizeof(limits));
+  close(fds[0]);
+  wait();
+  printf(1, "pff: idle child over %d pages: limit %d -> %d\n", PFF_IDLE, limits[0], limits[1]);
+  check("pff", after.maxpim >= first, "faulting process's limit shrank");
+  check("pff", limits[1] <= limits[0], "idle child's limit grew");
+}
+
+#define LOAD_PROCS 4
+#define LOAD_PAGES 24
+#define LOAD_ROUNDS 30
+
+// LOAD_PROCS processes walk their heaps at once; with 4 x 24 pages
+// they need more than GCLOCK_FRAMES.  Returns the ticks until all are
+// done.
+int loadRun(int on, struct loadstat *st) {
+  struct swapstat before, after;
+  int i, j, r, start, ticks;
+  char *heap;
+
+  loadctl(on, st);
+  swapstat(&before);
+  start = uptime();
+  for(i = 0; i < LOAD_PROCS; i++) {
+    if(fork() == 0) {
+      heap = sbrk(LOAD_PAGES * PAGESIZE);
+      for(r = 0; r < LOAD_ROUNDS; r++)
+        for(j = 0; j < LOAD_PAGES; j++)
+          heap[j * PAGESIZE]++;
+      exit();
+    }
+  }
+  for(i = 0; i < LOAD_PROCS; i++)
+    wait();
+  ticks = uptime() - start;
+  swapstat(&after);
+  printf(1, "load: control %s: %d ticks, %d pages swapped in, %d out\n",
+    on ? "on " : "off", ticks, after.ins - before.ins, after.outs - before.outs);
+  return ticks;
+}
+
+// Completion time of a thrashing mix with and without load control
+// suspending processes.  Only GCLOCK, whose processes share a pool of
+// frames, thrashes here; with per-process limits there is memory for
+// all of them and nothing is suspended.
+void loadBench(void) {
+  struct loadstat st, before, after;
+  int off, on;
+
+  if(loadctl(-1, &st) < 0) {
+    printf(1, "load: no load control without paging\n");
+    return;
+  }
+  off = loadRun(0, &before);
+  on = loadRun(1, &before);
+  loadctl(st.on, &after);
+  printf(1, "load: %d procs x %d pages: %d ticks off, %d on; %d of %d windows thrashing, "
+    "%d suspended (%d pages), %d resumed\n",
+    LOAD_PROCS, LOAD_PAGES, off, on,
+    after.thrashing - before.thrashing, after.windows - before.windows,
+    after.suspends - before.suspends, after.pages - before.pages,
+    after.resumes - before.resumes);
+}
+
+#define AGE_PROCS 4
+#define AGE_PAGES 12
+#define AGE_TICKS 100
+
+// Cost of the page aging sampler while AGE_PROCS processes touch
+// their pages for AGE_TICKS ticks (NFUA, LAPA and AQ only).
+void ageBench(void) {
+  struct agestat before, after;
+  int i, j, start, samples;
+  char *heap;
+
+  if(agestat(&before) < 0) {
+    printf(1, "age: this SELECTION does not age pages\n");
+    return;
+  }
+  start = uptime();
+  for(i = 0; i < AGE_PROCS; i++) {
+    if(fork() == 0) {
+      heap = sbrk(AGE_PAGES * PAGESIZE);
+      while(uptime() - start < AGE_TICKS)
+        for(j = 0; j < AGE_PAGES; j++)
+          heap[j * PAGESIZE]++;
+      exit();
+    }
+  }
+  for(i = 0; i < AGE_PROCS; i++)
+    wait();
+  agestat(&after);
+  samples = after.samples - before.samples;
+  check("age", samples > 0, "no samples taken");
+  printf(1, "age: %d procs x %d pages, %d ticks: %d samples over %d pages, %d put off, "
+    "%d x 1024 cycles (%d per sample)\n",
+    AGE_PROCS, AGE_PAGES, uptime() - start, samples, after.pages - before.pages,
+    after.deferred - before.deferred, after.kcycles - before.kcycles,
+    samples ? (after.kcycles - before.kcycles) * 1024 / samples : 0);
+}
+
+#define POLICY_PAGES 24
+#define POLICY_HOT 6
+#define POLICY_RESIDENT 12
+#define POLICY_ROUNDS 20
+
+// The hot pages between every two cold ones, the cold ones in a loop
+// larger than the resident limit.
+void policyMix(char *heap, int r) {
+  int j, k;
+
+  for(j = POLICY_HOT; j < POLICY_PAGES; j++) {
+    heap[j * PAGESIZE]++;
+    for(k = 0; k < POLICY_HOT; k++)
+      heap[k * PAGESIZE]++;
+  }
+}
+
+// All the pages in a loop, twice the resident limit: the worst case
+// for recency.
+void policyLoop(char *heap, int r) {
+  int j;
+
+  for(j = 0; j < POLICY_PAGES; j++)
+    heap[j * PAGESIZE]++;
+}
+
+// The hot pages over and over, and every fourth round one scan over
+// the others: a policy that resists scans keeps the hot pages.
+void policyScan(char *heap, int r) {
+  int j, k;
+
+  for(k = 0; k < 4; k++)
+    for(j = 0; j < POLICY_HOT; j++)
+      heap[j * PAGESIZE]++;
+  if(r % 4 == 3)
+    for(j = POLICY_HOT; j < POLICY_PAGES; j++)
+      heap[j * PAGESIZE]++;
+}
+
+// The access patterns under each replacement policy, chosen at run
+// time, then once more switching policy every round.  Refaults are
+// swap-in faults on pages evicted no more than a resident limit's
+// worth of evictions before: the policy's mistakes.
+void policyBench(void) {
+  static char *names[] = {"SCFIFO", "NFUA", "LAPA", "AQ", "ARC", "CLOCKPRO", "2Q"};
+  static struct {
+    char *name;
+    void (*pass)(char*, int);
+  } patterns[] = {
+    {"mix", policyMix},
+    {"loop", policyLoop},
+    {"scan", policyScan},
+  };
+  struct pgstat before, after;
+  int i, j, r, start;
+  char *heap;
+
+  if(setpolicy(-1, getpid()) < 0) {
+    printf(1, "policy: this SELECTION does not page\n");
+    return;
+  }
+  for(i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+    for(j = 0; j <= NPOLICY; j++) {
+      if(fork() == 0) {
+        if(j < NPOLICY)
+          setpolicy(j, getpid());
+        heap = sbrk(POLICY_PAGES * PAGESIZE);
+        for(r = 0; r < POLICY_PAGES; r++)
+          heap[r * PAGESIZE] = r;
+        if(setpglimit(POLICY_RESIDENT, 0) < 0)
+          printf(1, "policy: setpglimit(%d) failed\n", POLICY_RESIDENT);
+        pgstat(&before);
+        start = uptime();
+        for(r = 0; r < POLICY_ROUNDS; r++) {
+          if(j == NPOLICY)
+            setpolicy(r % NPOLICY, getpid());
+          patterns[i].pass(heap, r);
+        }
+        pgstat(&after);
+        printf(1, "policy: %s under %s, %d pages (%d hot), %d resident: "
+          "%d faults, %d refaults in %d ticks\n",
+          patterns[i].name, j < NPOLICY ? names[j] : "switching", POLICY_PAGES,
+          POLICY_HOT, after.maxpim, after.pf - before.pf, after.gh - before.gh,
+          uptime() - start);
+        exit();
+      }
+      wait();
+    }
+  }
+}
+
+#define CSV_PAGES 32
+#define CSV_RESIDENT 12
+
+void csvPattern(void (*pass)(char*, int)) {
+  char *heap;
+  int r;
+
+  heap = sbrk(POLICY_PAGES * PAGESIZE);
+  setpglimit(POLICY_RESIDENT, 0);
+  for(r = 0; r < POLICY_ROUNDS; r++)
+    pass(heap, r);
+}
+
+void csvMix(void) { csvPattern(policyMix); }
+void csvLoop(void) { csvPattern(policyLoop); }
+void csvScan(void) { csvPattern(policyScan); }
+
+// Sequential passes over a heap larger than the resident limit.
+void csvSeq(void) {
+  char *heap;
+  int r, j;
+
+  heap = sbrk(CSV_PAGES * PAGESIZE);
+  setpglimit(CSV_RESIDENT, 0);
+  for(r = 0; r < 10; r++)
+    for(j = 0; j < CSV_PAGES; j++)
+      heap[j * PAGESIZE]++;
+}
+
+// Pages touched at random, the same sequence every run.
+void csvRandom(void) {
+  char *heap;
+  uint seed = 1;
+  int n;
+
+  heap = sbrk(CSV_PAGES * PAGESIZE);
+  setpglimit(CSV_RESIDENT, 0);
+  for(n = 0; n < 1000; n++) {
+    seed = seed * 1103515245 + 12345;
+    heap[((seed >> 16) % CSV_PAGES) * PAGESIZE]++;
+  }
+}
+
+// Run the workload in a child, which prints one CSV row for make bench:
+//   csv,<workload>,<page faults>,<total swaps>,<ticks>,<free frames>
+// with the swap-in faults and pages paged out it took, and the frames
+// free once it was done.
+void csvRun(char *name, void (*fn)(void)) {
+  struct pgstat before, after;
+  struct swapstat st;
+  int start;
+
+  if(fork() == 0) {
+    pgstat(&before);
+    start = uptime();
+    fn();
+    pgstat(&after);
+    swapstat(&st);
+    printf(1, "csv,%s,%d,%d,%d,%d\n", name, after.pf - before.pf, after.ts - before.ts,
+      uptime() - start, st.free);
+    exit();
+  }
+  wait();
+}
+
+struct bench {
+  char *name;
+  void (*fn)(void);
+} benches[] = {
+  {"fork", forkBench},
+  {"cow", cowTest},
+  {"pipe", pipeTest},
+  {"fault", faultBench},
+  {"limit", limitBench},
+  {"thrash", thrashBench},
+  {"swapio", swapioBench},
+  {"scan", scanBench},
+  {"bcache", bcacheBench},
+  {"alloc", allocBench},
+  {"sbrk", sbrkBench},
+  {"lazy", lazyBench},
+  {"exec", execBench},
+  {"mmap", mmapBench},
+  {"advise", adviseBench},
+  {"pff", pffBench},
+  {"load", loadBench},
+  {"age", ageBench},
+  {"policy", policyBench},
+};
+
+struct bench csvs[] = {
+  {"seq", csvSeq},
+  {"random", csvRandom},
+  {"mix", csvMix},
+  {"loop", csvLoop},
+  {"scan", csvScan},
+};
 
 int main(int argc, char *argv[]) {
   int i;
+  if(argc > 1 && strcmp(argv[1], "csv") == 0) {
+    for(i = 0; i < sizeof(csvs) / sizeof(csvs[0]); i++)
+      csvRun(csvs[i].name, csvs[i].fn);
+    printf(1, "csv,done\n");
+    exit();
+  }
+  if(argc > 1 && strcmp(argv[1], "startup") == 0)
+    startup(argc > 2);
+  if(argc > 1) {
+    for(i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+      if(strcmp(argv[1], benches[i].name) == 0 || strcmp(argv[1], "all") == 0)
+        benches[i].fn();
+    if(failures)
+      printf(1, "ass3Tests: %d checks FAILED\n", failures);
+    exit();
+  }
+
   int buffSize = 1024;
   char *pages[100];  
   printf (1, "\n\n\n#########################\n\tTests:\n#########################\n\n\n");
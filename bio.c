@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -17,41 +17,79 @@
 // * B_VALID: the buffer data has been read from the disk.
 // * B_DIRTY: the buffer data has been modified
 //     and needs to be written to disk.
+//
+// Buffers are hashed by (dev, blockno) into NBUCKET chains, each with
+// its own lock, so lookups of different blocks do not serialize.
+// Recycling a buffer takes bcache.lock and picks the unused one
+// released longest ago (lastuse), from any chain.  The NBUF buffers
+// live in pages kalloc'd at boot.
 
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "pgstat.h"
 
-struct {
+#define NBUCKET 13
+#define BPERPAGE ((int)(PGSIZE / sizeof(struct buf)))
+
+struct bucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct buf *head;     // chain through next
+  uint hits, misses;    // lookups that found / did not find the block
+  uint contended;       // acquires that found the lock held
+};
 
-  // Linked list of all buffers, through prev/next.
-  // head.next is most recently used.
-  struct buf head;
+struct {
+  struct spinlock lock;  // one recycler at a time
+  struct bucket bucket[NBUCKET];
 } bcache;
 
+static struct bucket*
+bhash(uint dev, uint blockno)
+{
+  return &bcache.bucket[(dev * 31 + blockno) % NBUCKET];
+}
+
+static void
+bucketlock(struct bucket *bk)
+{
+  int busy = bk->lock.locked;
+
+  acquire(&bk->lock);
+  if(busy)
+    bk->contended++;
+}
+
 void
 binit(void)
 {
   struct buf *b;
+  struct bucket *bk;
+  int i;
 
   initlock(&bcache.lock, "bcache");
+  for(bk = bcache.bucket; bk < &bcache.bucket[NBUCKET]; bk++)
+    initlock(&bk->lock, "bcache.bucket");
 
 //PAGEBREAK!
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+  // Carve the buffers out of kalloc'd pages; they start out
+  // spread over the chains as blocks no one will ask for.
+  b = 0;
+  for(i = 0; i < NBUF; i++, b++){
+    if(i % BPERPAGE == 0 && (b = (struct buf*)kalloc()) == 0)
+      panic("binit");
+    memset(b, 0, sizeof(*b));
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->blockno = ~0;
+    bk = &bcache.bucket[i % NBUCKET];
+    b->next = bk->head;
+    bk->head = b;
   }
 }
 
@@ -61,35 +99,82 @@ binit(void)
 static struct buf*
 bget(uint dev, uint blockno)
 {
-  struct buf *b;
-
-  acquire(&bcache.lock);
+  struct buf *b, *victim, **pp;
+  struct bucket *bk = bhash(dev, blockno), *vbk, *k;
 
   // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+  bucketlock(bk);
+  for(b = bk->head; b; b = b->next){
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
-      release(&bcache.lock);
+      bk->hits++;
+      release(&bk->lock);
       acquiresleep(&b->lock);
       return b;
     }
   }
+  release(&bk->lock);
 
-  // Not cached; recycle an unused buffer.
+  // Not cached; recycle the least recently used unused buffer.
   // Even if refcnt==0, B_DIRTY indicates a buffer is in use
   // because log.c has modified it but not yet committed it.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->flags = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
+  acquire(&bcache.lock);
+  for(;;){
+    // Someone else may have brought the block in meanwhile.
+    bucketlock(bk);
+    for(b = bk->head; b; b = b->next){
+      if(b->dev == dev && b->blockno == blockno){
+        b->refcnt++;
+        bk->hits++;
+        release(&bk->lock);
+        release(&bcache.lock);
+        acquiresleep(&b->lock);
+        return b;
+      }
     }
+    release(&bk->lock);
+
+    victim = 0;
+    vbk = 0;
+    for(k = bcache.bucket; k < &bcache.bucket[NBUCKET]; k++){
+      bucketlock(k);
+      for(b = k->head; b; b = b->next){
+        if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0 &&
+           (victim == 0 || (int)(b->lastuse - victim->lastuse) < 0)){
+          victim = b;
+          vbk = k;
+        }
+      }
+      release(&k->lock);
+    }
+    if(victim == 0)
+      panic("bget: no buffers");
+
+    // Take it off its chain, unless it got used since the scan.
+    bucketlock(vbk);
+    if(victim->refcnt != 0 || (victim->flags & B_DIRTY) != 0){
+      release(&vbk->lock);
+      continue;
+    }
+    for(pp = &vbk->head; *pp != victim; pp = &(*pp)->next)
+      ;
+    *pp = victim->next;
+    release(&vbk->lock);
+    break;
   }
-  panic("bget: no buffers");
+
+  victim->dev = dev;
+  victim->blockno = blockno;
+  victim->flags = 0;
+  victim->refcnt = 1;
+  bucketlock(bk);
+  victim->next = bk->head;
+  bk->head = victim;
+  bk->misses++;
+  release(&bk->lock);
+  release(&bcache.lock);
+  acquiresleep(&victim->lock);
+  return victim;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -115,30 +200,62 @@ bwrite(struct buf *b)
   iderw(b);
 }
 
+// Start writing b's contents to disk and return without waiting,
+// so several writes can be in flight.  Must be locked, and stay
+// locked until bwait().
+void
+bwritestart(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("bwritestart");
+  b->flags |= B_DIRTY;
+  idesubmit(b);
+}
+
+// Wait for a write started by bwritestart().
+void
+bwait(struct buf *b)
+{
+  idecomplete(b);
+}
+
 // Release a locked buffer.
-// Move to the head of the MRU list.
+// Stamp it for the LRU choice in bget.
 void
 brelse(struct buf *b)
 {
+  struct bucket *bk;
+
   if(!holdingsleep(&b->lock))
     panic("brelse");
 
   releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
+  bk = bhash(b->dev, b->blockno);
+  bucketlock(bk);
   b->refcnt--;
   if (b->refcnt == 0) {
     // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->lastuse = ticks;
+  }
+  release(&bk->lock);
+}
+
+// Fill in the buffer cache counters.
+void
+bcachestat(struct bcstat *st)
+{
+  struct bucket *bk;
+
+  st->nbuf = NBUF;
+  st->hits = st->misses = st->contended = 0;
+  for(bk = bcache.bucket; bk < &bcache.bucket[NBUCKET]; bk++){
+    acquire(&bk->lock);
+    st->hits += bk->hits;
+    st->misses += bk->misses;
+    st->contended += bk->contended;
+    release(&bk->lock);
   }
-  
-  release(&bcache.lock);
 }
 //PAGEBREAK!
 // Blank page.
-
@@ -4,11 +4,13 @@ struct buf {
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
-  struct buf *next;
+  uint lastuse;      // ticks when last released, for LRU
+  struct buf *next;  // hash chain
   struct buf *qnext; // disk queue
+  char *page;        // B_PAGE: the PGSIZE bytes to transfer instead of data
   uchar data[BSIZE];
 };
 #define B_VALID 0x2  // buffer has been read from disk
 #define B_DIRTY 0x4  // buffer needs to be written to disk
+#define B_PAGE  0x8  // whole-page request (swap area), not in the cache
 
@@ -1,21 +1,36 @@
+struct agestat;
+struct bcstat;
 struct buf;
 struct context;
 struct file;
 struct inode;
+struct loadstat;
 struct pipe;
+struct pgpolicy;
+struct pgtrec;
 struct proc;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct sDet;
+struct swapstat;
+struct vma;
 typedef uint pte_t;
 
+// age.c
+void            agetick(int);
+int             agestat(struct agestat*);
+
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bwritestart(struct buf*);
+void            bwait(struct buf*);
+void            bcachestat(struct bcstat*);
 
 // console.c
 void            consoleinit(void);
@@ -53,10 +68,6 @@ struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, char*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
-int				createSwapFile(struct proc* p);
-int				readFromSwapFile(struct proc * p, char* buffer, uint placeOnFile, uint size);
-int				writeToSwapFile(struct proc* p, char* buffer, uint placeOnFile, uint size);
-int				removeSwapFile(struct proc* p);
 
 
 // sysfile
@@ -68,6 +79,12 @@ int				isdirempty(struct inode *dp);
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            idesubmit(struct buf*);
+void            idecomplete(struct buf*);
+void            idepagestart(struct buf*, uint, uint, char*, int);
+void            idepagewait(struct buf*);
+void            iderwpage(uint, uint, char*, int);
+void            idestat(uint*, uint*);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -79,6 +96,14 @@ char*           kalloc(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+void            kref(char*);
+int             krefcount(char*);
+void            kframeset(char*, struct proc*, char*);
+int             kframe(uint, struct proc**, char**);
+int             kfreeframes(void);
+int             kfreepages(void);
+char*           kzalloc(void);
+void            kzidle(void);
 
 // kbd.c
 void            kbdintr(void);
@@ -98,6 +123,17 @@ void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
 
+// mmap.c
+struct vma*     vmaLookup(struct proc*, uint);
+uint            vmaBottom(struct proc*);
+int             mmap(uint, int, int, struct file*, uint);
+int             munmap(uint, uint);
+void            munmapall(struct proc*);
+void            munmapold(struct vma*, struct proc*, pde_t*);
+int             mmapprefork(struct proc*);
+void            mmapfork(struct proc*, struct proc*);
+int             madvise(uint, uint, int);
+
 // mp.c
 extern int      ismp;
 void            mpinit(void);
@@ -106,6 +142,13 @@ void            mpinit(void);
 void            picenable(int);
 void            picinit(void);
 
+// pcache.c
+void            pcacheinit(void);
+char*           pcacheget(struct inode*, uint, uint);
+char*           pcacheput(struct inode*, uint, uint, char*);
+void            pcacheinval(struct inode*);
+int             pcachereclaim(void);
+
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
@@ -113,6 +156,10 @@ int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
 
 //PAGEBREAK: 16
+// policy.c
+extern struct pgpolicy *defpolicy;
+void            policyswitch(struct proc*, struct pgpolicy*);
+
 // proc.c
 int             cpuid(void);
 void            exit(void);
@@ -131,6 +178,13 @@ void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
 void            yield(void);
+void            gclockReclaim(int);
+void            kswapdinit(void);
+void            kswapdWake(void);
+void            pffWake(void);
+void            loadWake(void);
+int             setpolicy(int, int);
+int             loadctl(int, struct loadstat*);
 
 
 // swtch.S
@@ -151,6 +205,17 @@ void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
+// swap.c
+void            swapinit(void);
+int             swapalloc(void);
+void            swapdup(uint);
+void            swapfree(uint);
+void            swapread(uint, char*);
+void            swapwrite(uint, char*);
+void            swapreadv(uint*, char**, int);
+void            swapwritev(uint*, char**, int);
+void            swapstat(struct swapstat*);
+
 // string.c
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
@@ -174,9 +239,15 @@ void            timerinit(void);
 // trap.c
 void            idtinit(void);
 extern uint     ticks;
+extern uint     swapfaults;
 void            tvinit(void);
 extern struct spinlock tickslock;
 
+// trace.c
+void            pgtraceinit(void);
+void            pgtraceLog(int, uint, int);
+int             pgtrace(int, struct pgtrec*, int, int*);
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
@@ -200,10 +271,42 @@ void            clearpteu(pde_t *pgdir, char *uva);
 
 pte_t*			walkpgdir2(pde_t*, const void*);
 void			swapAndWrite(int , struct  proc*);
+void			adoptPages(struct proc*, uint);
 int 			pageSelector(struct proc*);
 void			removePageAndUpdate(void*,struct proc*);
-void			updatePages(void*,void*,struct proc*);
+int				updatePages(void*,void*,struct proc*);
 void 			swapAndRead(void*,struct proc*);
+int			demandPage(struct proc*, void*);
+int				makeWritable(struct proc*, uint, uint);
+int				pageContents(struct proc*, pde_t*, uint, char*);
+void			adviseRange(struct proc*, uint, uint, int);
+void			prefetchRange(struct proc*, uint, uint);
+int				swapOutAll(struct proc*);
+void			swapInSuspended(struct proc*);
+void			readAhead(void*,struct proc*);
+int				copyOnWrite(struct proc*, void*);
+int				bitmapAlloc(uint*, int);
+void			bitmapFree(uint*, int);
+int				pdLookup(struct proc*, void*);
+int				pdMoveDown(struct proc*, int);
+void			pdRelease(struct proc*, int);
+void			initPageDetails(struct proc*);
+void			freePageDetails(struct proc*);
+int				copyPageDetails(struct proc*, struct proc*);
+int				setPageLimits(struct proc*, int, int);
+int				pdSize(struct proc*);
+int				sdSize(struct proc*);
+struct sDet*	sdLookup(struct proc*, pte_t, void*);
+void			exchangePages(struct proc*, int, int);
+void			replacePage(void*,void*,struct proc*);
+void			releaseSwapSlot(struct sDet*,struct proc*);
+void			releaseSwapSlots(struct proc*);
+void			dropSwapCopy(struct proc*, int);
+void			paginginit(void);
+void			pagingLock(void);
+void			pagingUnlock(void);
+void			shareSwapSlots(struct proc*);
+int				copySwapSlots(struct proc*);
 
 
 
@@ -14,9 +14,12 @@ exec(char *path, char **argv)
   int i, off;
   uint argc, sz, sp, ustack[3+MAXARG+1];
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *exe, *oldexe;
   struct proghdr ph;
+  struct execseg seg[NEXECSEG];
+  int nseg;
   pde_t *pgdir, *oldpgdir;
+  struct vma oldvma[NVMA];
   struct proc *curproc = myproc();
 
   begin_op();
@@ -28,6 +31,7 @@ exec(char *path, char **argv)
   }
   ilock(ip);
   pgdir = 0;
+  exe = 0;
 
   // Check ELF header
   if(readi(ip, (char*)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -37,27 +41,13 @@ exec(char *path, char **argv)
 
   if((pgdir = setupkvm()) == 0)
     goto bad;
-  
-  //If the MACRO os not NONE, will create 2 level pageingFrameWork
-  #ifndef NONE
-  curproc->pim = 0;
-  curproc->sp = 0;
-  curproc->ts = 0;
-  curproc->pf = 0;
-  curproc->head = 0;
-  for(i = 0 ; i < MAX_PSYC_PAGES ; i++){
-    curproc->sd[i].va = 0;
-    curproc->sd[i].inSF = 0;
-    curproc->pd[i].va = 0;
-    curproc->pd[i].page = 0;
-    curproc->pd[i].accCount = 0;
-    curproc->pd[i].inMem = 0;
-  }
-  removeSwapFile(curproc);
-  createSwapFile(curproc);
-  #endif
-  // Load program into memory.
+  pagingLock();
+
+  // Load program into memory: the segments are only recorded, to be
+  // paged in from the file on first touch (demandPage()); any past
+  // NEXECSEG are read now.
   sz = 0;
+  nseg = 0;
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -67,13 +57,26 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
-    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+    if(ph.vaddr + ph.memsz >= KERNBASE)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
+    if(nseg < NEXECSEG){
+      seg[nseg].va = ph.vaddr;
+      seg[nseg].filesz = ph.filesz;
+      seg[nseg].memsz = ph.memsz;
+      seg[nseg].off = ph.off;
+      nseg++;
+      if(ph.vaddr + ph.memsz > sz)
+        sz = ph.vaddr + ph.memsz;
+      continue;
+    }
+    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+      goto bad;
     if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
       goto bad;
   }
+  exe = idup(ip);
   iunlockput(ip);
   end_op();
   ip = 0;
@@ -112,21 +115,52 @@ exec(char *path, char **argv)
   safestrcpy(curproc->name, last, sizeof(curproc->name));
 
   // Commit to the user image.
+  oldexe = curproc->exe;
+  curproc->exe = exe;
+  curproc->nseg = nseg;
+  memmove(curproc->seg, seg, sizeof(seg));
   oldpgdir = curproc->pgdir;
   curproc->pgdir = pgdir;
+  memmove(oldvma, curproc->vma, sizeof(oldvma));
+  memset(curproc->vma, 0, sizeof(curproc->vma));
   curproc->sz = sz;
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
   switchuvm(curproc);
+  #ifndef NONE
+  // Only now may the old image's swap slots go: until here a failed
+  // exec returns to it.  The new image's pages take their place.
+  releaseSwapSlots(curproc);
+  initPageDetails(curproc);
+  adoptPages(curproc, sz);
+  #endif
+  pagingUnlock();
+  // The old mmap() regions go with the old page table.  Their shared
+  // pages are never swapped out, so the writeback needs no swap details.
+  munmapold(oldvma, curproc, oldpgdir);
+  pagingLock();
   freevm(oldpgdir);
+  pagingUnlock();
+  if(oldexe){
+    begin_op();
+    iput(oldexe);
+    end_op();
+  }
   return 0;
 
  bad:
-  if(pgdir)
+  if(pgdir){
     freevm(pgdir);
+    pagingUnlock();
+  }
   if(ip){
     iunlockput(ip);
     end_op();
   }
+  if(exe){
+    begin_op();
+    iput(exe);
+    end_op();
+  }
   return -1;
 }
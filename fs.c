@@ -182,9 +182,9 @@ iinit(int dev)
 
   readsb(dev, &sb);
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
- inodestart %d bmap start %d\n", sb.size, sb.nblocks,
+ inodestart %d bmap start %d swapstart %d nswap %d\n", sb.size, sb.nblocks,
           sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
-          sb.bmapstart);
+          sb.bmapstart, sb.swapstart, sb.nswap);
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -413,6 +413,7 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  pcacheinval(ip);
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -497,6 +498,7 @@ writei(struct inode *ip, char *src, uint off, uint n)
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  pcacheinval(ip);
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
@@ -670,140 +672,3 @@ nameiparent(char *path, char *name)
 {
   return namex(path, 1, name);
 }
-
-#include "fcntl.h"
-#define DIGITS 14
-
-char* itoa(int i, char b[]){
-    char const digit[] = "0123456789";
-    char* p = b;
-    if(i<0){
-        *p++ = '-';
-        i *= -1;
-    }
-    int shifter = i;
-    do{ //Move to where representation ends
-        ++p;
-        shifter = shifter/10;
-    }while(shifter);
-    *p = '\0';
-    do{ //Move back, inserting digits as u go
-        *--p = digit[i%10];
-        i = i/10;
-    }while(i);
-    return b;
-}
-//remove swap file of proc p;
-int
-removeSwapFile(struct proc* p)
-{
-  //path of proccess
-  char path[DIGITS];
-  memmove(path,"/.swap", 6);
-  itoa(p->pid, path+ 6);
-
-  struct inode *ip, *dp;
-  struct dirent de;
-  char name[DIRSIZ];
-  uint off;
-
-  if(0 == p->swapFile)
-  {
-    return -1;
-  }
-  fileclose(p->swapFile);
-
-  begin_op();
-  if((dp = nameiparent(path, name)) == 0)
-  {
-    end_op();
-    return -1;
-  }
-
-  ilock(dp);
-
-    // Cannot unlink "." or "..".
-  if(namecmp(name, ".") == 0 || namecmp(name, "..") == 0)
-     goto bad;
-
-  if((ip = dirlookup(dp, name, &off)) == 0)
-    goto bad;
-  ilock(ip);
-
-  if(ip->nlink < 1)
-    panic("unlink: nlink < 1");
-  if(ip->type == T_DIR && !isdirempty(ip)){
-    iunlockput(ip);
-    goto bad;
-  }
-
-  memset(&de, 0, sizeof(de));
-  if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-    panic("unlink: writei");
-  if(ip->type == T_DIR){
-    dp->nlink--;
-    iupdate(dp);
-  }
-  iunlockput(dp);
-
-  ip->nlink--;
-  iupdate(ip);
-  iunlockput(ip);
-
-  end_op();
-
-  return 0;
-
-  bad:
-    iunlockput(dp);
-    end_op();
-    return -1;
-
-}
-
-
-//return 0 on success
-int
-createSwapFile(struct proc* p)
-{
-
-  char path[DIGITS];
-  memmove(path,"/.swap", 6);
-  itoa(p->pid, path+ 6);
-
-    begin_op();
-    struct inode * in = create(path, T_FILE, 0, 0);
-  iunlock(in);
-
-  p->swapFile = filealloc();
-  if (p->swapFile == 0)
-    panic("no slot for files on /store");
-
-  p->swapFile->ip = in;
-  p->swapFile->type = FD_INODE;
-  p->swapFile->off = 0;
-  p->swapFile->readable = O_WRONLY;
-  p->swapFile->writable = O_RDWR;
-    end_op();
-
-    return 0;
-}
-
-//return as sys_write (-1 when error)
-int
-writeToSwapFile(struct proc * p, char* buffer, uint placeOnFile, uint size)
-{
-  p->swapFile->off = placeOnFile;
-
-  return filewrite(p->swapFile, buffer, size);
-
-}
-
-//return as sys_read (-1 when error)
-int
-readFromSwapFile(struct proc * p, char* buffer, uint placeOnFile, uint size)
-{
-  p->swapFile->off = placeOnFile;
-
-  return fileread(p->swapFile, buffer,  size);
-}
@@ -23,15 +23,25 @@
 #define IDE_CMD_WRITE 0x30
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
+#define IDE_CMD_SETMUL 0xc6
 
-// idequeue points to the buf now being read/written to the disk.
-// idequeue->qnext points to the next buf to be processed.
+// idequeue holds the bufs waiting for the disk, in the order they
+// will be started: a C-LOOK elevator sweeps up the disk and then jumps
+// back to the lowest waiting block.  The first idenbuf bufs are the
+// request in flight, adjacent blocks merged into one multi-sector
+// transfer.  idetail is the last buf, so a request that continues the
+// sweep is appended without walking the queue.
 // You must hold idelock while manipulating queue.
 
 static struct spinlock idelock;
 static struct buf *idequeue;
+static struct buf *idetail;
+static int idenbuf;    // bufs in the request in flight
+static uint idepos;    // block the elevator is at
 
 static int havedisk1;
+static uint idereqs;   // requests started, for swapstat()
+static uint idesecs;   // sectors they moved
 static void idestart(struct buf*);
 
 // Wait for IDE disk to become ready.
@@ -65,80 +75,167 @@ ideinit(void)
     }
   }
 
+  // Let the disks move a whole page per interrupt with
+  // RDMUL/WRMUL, for the swap area and merged requests.
+  if(havedisk1){
+    outb(0x1f2, PGSIZE/SECTOR_SIZE);
+    outb(0x1f7, IDE_CMD_SETMUL);
+    idewait(0);
+  }
+
   // Switch back to disk 0.
   outb(0x1f6, 0xe0 | (0<<4));
+  idewait(0);
+  outb(0x1f2, PGSIZE/SECTOR_SIZE);
+  outb(0x1f7, IDE_CMD_SETMUL);
+  idewait(0);
 }
 
-// Start the request for b.  Caller must hold idelock.
+// Sectors moved by b.
+static int
+idesectors(struct buf *b)
+{
+  return (b->flags & B_PAGE) ? PGSIZE/SECTOR_SIZE : BSIZE/SECTOR_SIZE;
+}
+
+// Start the request at the head of the queue, merged with the bufs
+// after it that continue it on the disk in the same direction, up to
+// a page of sectors.  Caller must hold idelock.
 static void
 idestart(struct buf *b)
 {
+  struct buf *q, *last;
+  int n, nsect;
+
   if(b == 0)
     panic("idestart");
-  if(b->blockno >= FSSIZE)
+  if(b->blockno >= FSSIZE + SWAPBLOCKS)
     panic("incorrect blockno");
-  int sector_per_block =  BSIZE/SECTOR_SIZE;
-  int sector = b->blockno * sector_per_block;
-  int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
-  int write_cmd = (sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
+  int sector = b->blockno * (BSIZE/SECTOR_SIZE);
+  nsect = idesectors(b);
+  n = 1;
+  for(last = b, q = b->qnext; q; last = q, q = q->qnext){
+    if(q->dev != b->dev || ((q->flags ^ b->flags) & (B_DIRTY|B_PAGE)) ||
+       q->blockno != last->blockno + idesectors(last)/(BSIZE/SECTOR_SIZE) ||
+       nsect + idesectors(q) > PGSIZE/SECTOR_SIZE)
+      break;
+    nsect += idesectors(q);
+    n++;
+  }
+  int read_cmd = (nsect == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
+  int write_cmd = (nsect == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
 
-  if (sector_per_block > 7) panic("idestart");
+  if (nsect > PGSIZE/SECTOR_SIZE) panic("idestart");
+  idenbuf = n;
+  idepos = b->blockno;
+  idereqs++;
+  idesecs += nsect;
 
   idewait(0);
   outb(0x3f6, 0);  // generate interrupt
-  outb(0x1f2, sector_per_block);  // number of sectors
+  outb(0x1f2, nsect);  // number of sectors
   outb(0x1f3, sector & 0xff);
   outb(0x1f4, (sector >> 8) & 0xff);
   outb(0x1f5, (sector >> 16) & 0xff);
   outb(0x1f6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
   if(b->flags & B_DIRTY){
     outb(0x1f7, write_cmd);
-    outsl(0x1f0, b->data, BSIZE/4);
+    for(q = b; n > 0; q = q->qnext, n--){
+      if(q->flags & B_PAGE)
+        outsl(0x1f0, q->page, PGSIZE/4);
+      else
+        outsl(0x1f0, q->data, BSIZE/4);
+    }
   } else {
     outb(0x1f7, read_cmd);
   }
 }
 
+// Position of b in the elevator's order: blocks behind the one in
+// flight wait for the next sweep.
+static uint
+idekey(struct buf *b)
+{
+  return b->blockno < idepos ? b->blockno + FSSIZE + SWAPBLOCKS : b->blockno;
+}
+
+// Add b to idequeue in elevator order.  Caller must hold idelock.
+static void
+ideenqueue(struct buf *b)
+{
+  struct buf **pp;
+  int i;
+
+  b->qnext = 0;
+  if(idequeue == 0){
+    idequeue = idetail = b;
+    return;
+  }
+  if(idekey(b) >= idekey(idetail)){
+    idetail->qnext = b;
+    idetail = b;
+    return;
+  }
+  // Never in front of the request in flight.
+  pp = &idequeue;
+  for(i = 0; i < idenbuf; i++)
+    pp = &(*pp)->qnext;
+  for(; idekey(*pp) <= idekey(b); pp = &(*pp)->qnext)
+    ;
+  b->qnext = *pp;
+  *pp = b;
+}
+
 // Interrupt handler.
 void
 ideintr(void)
 {
   struct buf *b;
+  int n, ok;
 
-  // First queued buffer is the active request.
+  // The first idenbuf queued buffers are the active request.
   acquire(&idelock);
 
   if((b = idequeue) == 0){
     release(&idelock);
     return;
   }
-  idequeue = b->qnext;
 
   // Read data if needed.
-  if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
-    insl(0x1f0, b->data, BSIZE/4);
+  ok = !(b->flags & B_DIRTY) && idewait(1) >= 0;
+  for(n = idenbuf; n > 0; n--){
+    b = idequeue;
+    idequeue = b->qnext;
+    if(ok){
+      if(b->flags & B_PAGE)
+        insl(0x1f0, b->page, PGSIZE/4);
+      else
+        insl(0x1f0, b->data, BSIZE/4);
+    }
 
-  // Wake process waiting for this buf.
-  b->flags |= B_VALID;
-  b->flags &= ~B_DIRTY;
-  wakeup(b);
+    // Wake process waiting for this buf.
+    b->flags |= B_VALID;
+    b->flags &= ~B_DIRTY;
+    wakeup(b);
+  }
+  idenbuf = 0;
 
   // Start disk on next buf in queue.
   if(idequeue != 0)
     idestart(idequeue);
+  else
+    idetail = 0;
 
   release(&idelock);
 }
 
 //PAGEBREAK!
-// Sync buf with disk.
-// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
-// Else if B_VALID is not set, read buf from disk, set B_VALID.
+// Queue b for the disk and return without waiting for it: if B_DIRTY
+// is set it will be written, else if B_VALID is not set it will be
+// read.  b must stay locked until idecomplete() says it is done.
 void
-iderw(struct buf *b)
+idesubmit(struct buf *b)
 {
-  struct buf **pp;
-
   if(!holdingsleep(&b->lock))
     panic("iderw: buf not locked");
   if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
@@ -148,21 +245,78 @@ iderw(struct buf *b)
 
   acquire(&idelock);  //DOC:acquire-lock
 
-  // Append b to idequeue.
-  b->qnext = 0;
-  for(pp=&idequeue; *pp; pp=&(*pp)->qnext)  //DOC:insert-queue
-    ;
-  *pp = b;
+  ideenqueue(b);
 
   // Start disk if necessary.
   if(idequeue == b)
     idestart(b);
 
-  // Wait for request to finish.
+  release(&idelock);
+}
+
+// Wait for a buf queued by idesubmit(): afterwards B_DIRTY is clear
+// and B_VALID set.
+void
+idecomplete(struct buf *b)
+{
+  acquire(&idelock);
   while((b->flags & (B_VALID|B_DIRTY)) != B_VALID){
     sleep(b, &idelock);
   }
+  release(&idelock);
+}
 
+// Sync buf with disk.
+// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
+// Else if B_VALID is not set, read buf from disk, set B_VALID.
+void
+iderw(struct buf *b)
+{
+  idesubmit(b);
+  idecomplete(b);
+}
+
+// Submit a read (or, if write is set, a write) of the page at pg from
+// (to) the PGSIZE/BSIZE blocks at blockno as one multi-sector request.
+// b is the caller's, not a cache buffer; idepagewait() waits for it.
+// Used by the swap area, which does not go through the buffer cache.
+void
+idepagestart(struct buf *b, uint dev, uint blockno, char *pg, int write)
+{
+  memset(b, 0, sizeof(*b));
+  initsleeplock(&b->lock, "idepage");
+  acquiresleep(&b->lock);
+  b->dev = dev;
+  b->blockno = blockno;
+  b->page = pg;
+  b->flags = B_PAGE | (write ? B_DIRTY : 0);
+  idesubmit(b);
+}
+
+// Wait for a page request started by idepagestart().
+void
+idepagewait(struct buf *b)
+{
+  idecomplete(b);
+  releasesleep(&b->lock);
+}
 
+// Read or write one page, waiting for it.
+void
+iderwpage(uint dev, uint blockno, char *pg, int write)
+{
+  struct buf b;
+
+  idepagestart(&b, dev, blockno, pg, write);
+  idepagewait(&b);
+}
+
+// Number of requests started and sectors moved since boot.
+void
+idestat(uint *reqs, uint *secs)
+{
+  acquire(&idelock);
+  *reqs = idereqs;
+  *secs = idesecs;
   release(&idelock);
 }
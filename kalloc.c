@@ -10,6 +10,7 @@
 #include "spinlock.h"
 
 void freerange(void *vstart, void *vend);
+static struct run *kzgrab(int);
 extern char end[]; // first address after kernel loaded from ELF file
                    // defined by the kernel linker script in kernel.ld
 
@@ -17,13 +18,44 @@ struct run {
   struct run *next;
 };
 
+// Each CPU keeps a magazine of free frames, so kalloc() and kfree()
+// normally take only that CPU's lock.  An empty magazine is refilled
+// KBATCH frames at a time from the global list or, once that runs
+// dry, from another CPU's magazine; a magazine past KMAG frames
+// drains KBATCH of them back to the global list.
+//
+// The idle loop of scheduler() also keeps up to KZERO frames per CPU
+// zeroed in advance, for kzalloc().  They are still free frames:
+// kalloc() takes them when nothing else is left.
+#define KMAG   64
+#define KBATCH 16
+#define KZERO  32
+#define KZBATCH 4               // frames zeroed per idle pass
+
+struct kcache {
+  struct spinlock lock;
+  struct run *freelist;
+  int n;                        // frames in freelist
+  struct run *zerolist;         // frames already zeroed
+  int nzero;
+};
+
 struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  struct kcache cache[NCPU];
+  uchar ref[PHYSTOP/PGSIZE];    // mappings of each frame (copy-on-write)
+#ifdef GCLOCK
+  struct {
+    struct proc *owner;         // process the frame is paged for, 0 if none
+    char *va;                   // user virtual address in that process
+  } frame[PHYSTOP/PGSIZE];      // frame table swept by the global clock
+  int nuser;                    // frames with an owner
+#endif
 } kmem;
 
-int freePages;
+int freePages;        // frames on the global list; see kfreepages()
 int totalFreePages;
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
@@ -33,9 +65,13 @@ int totalFreePages;
 void
 kinit1(void *vstart, void *vend)
 {
+  int i;
+
   freePages = 0;
   totalFreePages = 0;
   initlock(&kmem.lock, "kmem");
+  for(i = 0; i < NCPU; i++)
+    initlock(&kmem.cache[i].lock, "kcache");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -58,30 +94,137 @@ freerange(void *vstart, void *vend)
   }
   
 }
+
+// This CPU's magazine.  The process may move to another CPU
+// afterwards, which is harmless: magazines are locked.
+static struct kcache*
+mycache(void)
+{
+  int id;
+
+  pushcli();
+  id = cpuid();
+  popcli();
+  return &kmem.cache[id];
+}
+
+// Take up to KBATCH frames from the global list or, if it is empty,
+// from the first other magazine that has some.  Returns them chained,
+// with their number in *n.  Caller must not hold a magazine lock.
+static struct run*
+kgrab(struct kcache *mine, int *n)
+{
+  struct run *head, **tail;
+  struct kcache *c;
+
+  head = 0;
+  tail = &head;
+  *n = 0;
+  acquire(&kmem.lock);
+  while(*n < KBATCH && kmem.freelist){
+    *tail = kmem.freelist;
+    kmem.freelist = kmem.freelist->next;
+    tail = &(*tail)->next;
+    (*n)++;
+    freePages--;
+  }
+  release(&kmem.lock);
+  for(c = kmem.cache; *n == 0 && c < &kmem.cache[NCPU]; c++){
+    if(c == mine || c->n == 0)
+      continue;
+    acquire(&c->lock);
+    while(*n < KBATCH && c->n > *n){
+      *tail = c->freelist;
+      c->freelist = c->freelist->next;
+      c->n--;
+      tail = &(*tail)->next;
+      (*n)++;
+    }
+    release(&c->lock);
+  }
+  *tail = 0;
+  return head;
+}
+
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
 // call to kalloc().  (The exception is when
 // initializing the allocator; see kinit above.)
+// A frame shared by copy-on-write fork is only put
+// back on the free list when its last mapping drops it.
 void
 kfree(char *v)
 {
-  struct run *r;
+  struct run *r, *drain, **tail;
+  struct kcache *c;
+  uint n = V2P(v) / PGSIZE;
+  int i;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  // A frame with one mapping has no other holder that could
+  // change its count, so only shared frames need the lock.
+  if(kmem.ref[n] > 1){
+    if(kmem.use_lock)
+      acquire(&kmem.lock);
+    if(kmem.ref[n] > 1){
+      kmem.ref[n]--;
+      if(kmem.use_lock)
+        release(&kmem.lock);
+      return;
+    }
+    if(kmem.use_lock)
+      release(&kmem.lock);
+  }
+  kmem.ref[n] = 0;
+#ifdef GCLOCK
+  if(kmem.frame[n].owner){
+    if(kmem.use_lock)
+      acquire(&kmem.lock);
+    kmem.frame[n].owner = 0;
+    kmem.nuser--;
+    if(kmem.use_lock)
+      release(&kmem.lock);
+  }
+#endif
+
+#ifdef DEBUG
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
+#endif
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
   r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  freePages++;
-  if(kmem.use_lock)
+  if(!kmem.use_lock){
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+    freePages++;
+    return;
+  }
+
+  c = mycache();
+  acquire(&c->lock);
+  r->next = c->freelist;
+  c->freelist = r;
+  c->n++;
+  drain = 0;
+  if(c->n > KMAG){
+    drain = c->freelist;
+    for(tail = &drain, i = 0; i < KBATCH; i++)
+      tail = &(*tail)->next;
+    c->freelist = *tail;
+    c->n -= KBATCH;
+  }
+  release(&c->lock);
+
+  if(drain){
+    acquire(&kmem.lock);
+    *tail = kmem.freelist;
+    kmem.freelist = drain;
+    freePages += KBATCH;
     release(&kmem.lock);
+  }
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -90,17 +233,217 @@ kfree(char *v)
 char*
 kalloc(void)
 {
+  struct run *r, *more;
+  struct kcache *c;
+  int n;
+
+  if(!kmem.use_lock){
+    r = kmem.freelist;
+    if(r){
+      kmem.freelist = r->next;
+      freePages--;
+    }
+  } else {
+    c = mycache();
+    acquire(&c->lock);
+    if(c->n == 0){
+      release(&c->lock);
+      more = kgrab(c, &n);
+      acquire(&c->lock);
+      while(more){
+        r = more;
+        more = more->next;
+        r->next = c->freelist;
+        c->freelist = r;
+        c->n++;
+      }
+    }
+    r = c->freelist;
+    if(r){
+      c->freelist = r->next;
+      c->n--;
+    }
+    release(&c->lock);
+    if(r == 0)
+      r = kzgrab(0);
+  }
+  if(r)
+    kmem.ref[V2P(r) / PGSIZE] = 1;
+  return (char*)r;
+}
+
+static struct run*
+kzpop(struct kcache *c)
+{
+  struct run *r;
+
+  if(c->nzero == 0)
+    return 0;
+  acquire(&c->lock);
+  if((r = c->zerolist) != 0){
+    c->zerolist = r->next;
+    c->nzero--;
+  }
+  release(&c->lock);
+  return r;
+}
+
+// Take a zeroed frame from this CPU's pool or, unless only is set,
+// from any pool.
+static struct run*
+kzgrab(int only)
+{
+  struct kcache *mine = mycache();
+  struct run *r;
+  int i;
+
+  if((r = kzpop(mine)) != 0 || only)
+    return r;
+  for(i = 0; r == 0 && i < NCPU; i++)
+    if(&kmem.cache[i] != mine)
+      r = kzpop(&kmem.cache[i]);
+  return r;
+}
+
+// Allocate a page that is all zeros, from the pre-zeroed pool if it
+// has one.  Returns 0 if the memory cannot be allocated.
+char*
+kzalloc(void)
+{
+  struct run *r;
+
+  if(kmem.use_lock && (r = kzgrab(1)) != 0){
+    kmem.ref[V2P(r) / PGSIZE] = 1;
+    r->next = 0;      // the only word the pool wrote
+    return (char*)r;
+  }
+  if((r = (struct run*)kalloc()) != 0)
+    memset(r, 0, PGSIZE);
+  return (char*)r;
+}
+
+// Called by the idle scheduler loop: zero a few free frames
+// into this CPU's pool.
+void
+kzidle(void)
+{
+  struct kcache *c = mycache();
   struct run *r;
+  int i;
+
+  if(!kmem.use_lock)    // other CPUs idle before kinit2() is done
+    return;
+  for(i = 0; i < KZBATCH && c->nzero < KZERO; i++){
+    if(kfreepages() - c->nzero <= KZERO || (r = (struct run*)kalloc()) == 0)
+      return;
+    memset(r, 0, PGSIZE);
+    kmem.ref[V2P(r) / PGSIZE] = 0;
+    acquire(&c->lock);
+    r->next = c->zerolist;
+    c->zerolist = r;
+    c->nzero++;
+    release(&c->lock);
+  }
+}
+
+// Free frames, adding up the global list and the magazines without
+// locking them: a snapshot for reports and reclaim heuristics.
+int
+kfreepages(void)
+{
+  int i, n;
+
+  n = freePages;
+  for(i = 0; i < NCPU; i++)
+    n += kmem.cache[i].n + kmem.cache[i].nzero;
+  return n;
+}
+
+// Add a mapping to the frame at v, which must have
+// been returned by kalloc().  Used by copy-on-write fork.
+void
+kref(char *v)
+{
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kref");
 
   if(kmem.use_lock)
     acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r){
-    kmem.freelist = r->next;
-    freePages--;
+  if(kmem.ref[V2P(v) / PGSIZE] < 1 || kmem.ref[V2P(v) / PGSIZE] == 0xff)
+    panic("kref: bad count");
+  kmem.ref[V2P(v) / PGSIZE]++;
+  if(kmem.use_lock)
+    release(&kmem.lock);
+}
+
+// Number of mappings of the frame at v.
+int
+krefcount(char *v)
+{
+  int n;
+
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  n = kmem.ref[V2P(v) / PGSIZE];
+  if(kmem.use_lock)
+    release(&kmem.lock);
+  return n;
+}
+
+#ifdef GCLOCK
+// Record that the frame at v holds page va of p,
+// for the global clock.
+void
+kframeset(char *v, struct proc *p, char *va)
+{
+  uint n = V2P(v) / PGSIZE;
+
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  if(kmem.frame[n].owner == 0)
+    kmem.nuser++;
+  kmem.frame[n].owner = p;
+  kmem.frame[n].va = va;
+  if(kmem.use_lock)
+    release(&kmem.lock);
+}
+
+// Owner and virtual address of frame n.  Returns -1 if the frame
+// has no owner or is shared copy-on-write.
+int
+kframe(uint n, struct proc **p, char **va)
+{
+  int r = -1;
+
+  if(kmem.frame[n].owner == 0)
+    return -1;
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  if(kmem.frame[n].owner && kmem.ref[n] == 1){
+    *p = kmem.frame[n].owner;
+    *va = kmem.frame[n].va;
+    r = 0;
   }
   if(kmem.use_lock)
     release(&kmem.lock);
-  return (char*)r;
+  return r;
 }
 
+#endif
+
+// Frames user pages may still take before they have to be
+// swapped out (under GCLOCK, out of the GCLOCK_FRAMES budget).
+int
+kfreeframes(void)
+{
+#ifdef GCLOCK
+  int n;
+
+  int free = kfreepages();
+
+  n = GCLOCK_FRAMES - kmem.nuser;
+  return n < free ? n : free;
+#else
+  return kfreepages();
+#endif
+}
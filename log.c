@@ -47,9 +47,30 @@ struct log {
 };
 struct log log;
 
+// Log and home writes are started LOGBATCH at a time and then waited
+// for together, so the disk can merge adjacent ones into one
+// multi-sector request (at most a page of sectors).
+#define LOGBATCH 8
+
 static void recover_from_log(void);
 static void commit();
 
+// Blocks to write at once from tail on.  The logged blocks are pinned
+// in the cache, so a batch must fit in the buffers left over.
+static int
+logbatch(int tail)
+{
+  int n = NBUF - log.lh.n;
+
+  if (n > LOGBATCH)
+    n = LOGBATCH;
+  if (n < 1)
+    n = 1;
+  if (n > log.lh.n - tail)
+    n = log.lh.n - tail;
+  return n;
+}
+
 void
 initlog(int dev)
 {
@@ -69,15 +90,22 @@ initlog(int dev)
 static void
 install_trans(void)
 {
-  int tail;
-
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    brelse(lbuf);
-    brelse(dbuf);
+  int tail, i, n;
+  struct buf *dbuf[LOGBATCH];
+
+  for (tail = 0; tail < log.lh.n; tail += n) {
+    n = logbatch(tail);
+    for (i = 0; i < n; i++) {
+      struct buf *lbuf = bread(log.dev, log.start+tail+i+1); // read log block
+      dbuf[i] = bread(log.dev, log.lh.block[tail+i]); // read dst
+      memmove(dbuf[i]->data, lbuf->data, BSIZE);  // copy block to dst
+      brelse(lbuf);
+      bwritestart(dbuf[i]);  // write dst to disk
+    }
+    for (i = 0; i < n; i++) {
+      bwait(dbuf[i]);
+      brelse(dbuf[i]);
+    }
   }
 }
 
@@ -177,15 +205,22 @@ end_op(void)
 static void
 write_log(void)
 {
-  int tail;
-
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    brelse(from);
-    brelse(to);
+  int tail, i, n;
+  struct buf *to[LOGBATCH];
+
+  for (tail = 0; tail < log.lh.n; tail += n) {
+    n = logbatch(tail);
+    for (i = 0; i < n; i++) {
+      to[i] = bread(log.dev, log.start+tail+i+1); // log block
+      struct buf *from = bread(log.dev, log.lh.block[tail+i]); // cache block
+      memmove(to[i]->data, from->data, BSIZE);
+      brelse(from);
+      bwritestart(to[i]);  // write the log
+    }
+    for (i = 0; i < n; i++) {
+      bwait(to[i]);
+      brelse(to[i]);
+    }
   }
 }
 
@@ -19,6 +19,8 @@ main(void)
 {
   kinit1(end, P2V(4*1024*1024)); // phys page allocator
   kvmalloc();      // kernel page table
+  paginginit();    // paging lock
+  pgtraceinit();   // page fault trace rings
   mpinit();        // detect other processors
   lapicinit();     // interrupt controller
   seginit();       // segment descriptors
@@ -29,11 +31,16 @@ main(void)
   pinit();         // process table
   tvinit();        // trap vectors
   binit();         // buffer cache
+  swapinit();      // swap area
+  pcacheinit();    // executable page cache
   fileinit();      // file table
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
   userinit();      // first user process
+#ifndef NONE
+  kswapdinit();    // page reclaim thread
+#endif
   mpmain();        // finish this processor's setup
 }
 
@@ -17,6 +17,7 @@ extern uchar _binary_fs_img_start[], _binary_fs_img_size[];
 
 static int disksize;
 static uchar *memdisk;
+static uint idereqs, idesecs;
 
 void
 ideinit(void)
@@ -50,6 +51,8 @@ iderw(struct buf *b)
     panic("iderw: block out of range");
 
   p = memdisk + b->blockno*BSIZE;
+  idereqs++;
+  idesecs += BSIZE/512;
 
   if(b->flags & B_DIRTY){
     b->flags &= ~B_DIRTY;
@@ -58,3 +61,54 @@ iderw(struct buf *b)
     memmove(b->data, p, BSIZE);
   b->flags |= B_VALID;
 }
+
+// Requests complete at once.
+void
+idesubmit(struct buf *b)
+{
+  iderw(b);
+}
+
+void
+idecomplete(struct buf *b)
+{
+}
+
+// Read or write a whole page of blocks (swap area).
+void
+idepagestart(struct buf *b, uint dev, uint blockno, char *pg, int write)
+{
+  uchar *p;
+
+  if(dev != 1)
+    panic("iderwpage: request not for disk 1");
+  if(blockno + PGSIZE/BSIZE > disksize)
+    panic("iderwpage: block out of range");
+
+  p = memdisk + blockno*BSIZE;
+  idereqs++;
+  idesecs += PGSIZE/512;
+  if(write)
+    memmove(p, pg, PGSIZE);
+  else
+    memmove(pg, p, PGSIZE);
+}
+
+void
+idepagewait(struct buf *b)
+{
+}
+
+void
+iderwpage(uint dev, uint blockno, char *pg, int write)
+{
+  idepagestart(0, dev, blockno, pg, write);
+}
+
+// Number of requests and sectors moved since boot.
+void
+idestat(uint *reqs, uint *secs)
+{
+  *reqs = idereqs;
+  *secs = idesecs;
+}
@@ -0,0 +1,12 @@
+#define PROT_READ     0x1
+#define PROT_WRITE    0x2
+#define MAP_SHARED    0x1   // writes reach the file
+#define MAP_PRIVATE   0x2   // writes stay in the process
+#define MAP_ANONYMOUS 0x4   // zero filled, no file
+
+// madvise() advice
+#define MADV_NORMAL     0
+#define MADV_RANDOM     1   // no readahead
+#define MADV_SEQUENTIAL 2   // read ahead, evict pages behind the scan first
+#define MADV_WILLNEED   3   // bring in now
+#define MADV_DONTNEED   4   // drop; the next touch maps the page afresh
@@ -0,0 +1,380 @@
+// Memory mapped regions.
+//
+// mmap() only reserves address space, top down from MMAPTOP, and
+// records it in one of the process's vma slots; demandPage() maps each
+// page on first touch, from the file or zeroed.  From then on the
+// pages of a MAP_PRIVATE region are paged like heap pages: counted in
+// pim, chosen for eviction by the replacement policy, and dropped
+// rather than written to swap while they still match the file
+// (PTE_DZ).  A fork child gets them copy-on-write like the rest of its
+// memory.
+//
+// The pages of a MAP_SHARED region are not paged: they stay resident,
+// outside pim, so that a fork child can map the parent's frames
+// writable and each sees the other's writes.  fork() maps all of them
+// first (mmapprefork()).  Writes reach the file when a process unmaps
+// the region with munmap(), exec() or exit(); until then processes
+// that read the file, or map it themselves, do not see them.
+// MADV_DONTNEED writes the pages back and unmaps them from the caller
+// alone, which maps them afresh from the file.
+//
+// madvise() lives here too: it applies to any user pages, heap or
+// mapped.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "defs.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "mman.h"
+
+// The region of p holding va, or 0.
+struct vma*
+vmaLookup(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->start && va >= v->start && va < v->end)
+      return v;
+  return 0;
+}
+
+// Lowest address mapped by mmap(), or MMAPTOP: the heap may grow up
+// to it.
+uint
+vmaBottom(struct proc *p)
+{
+  struct vma *v;
+  uint bottom = MMAPTOP;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->start && v->start < bottom)
+      bottom = v->start;
+  return bottom;
+}
+
+// Map len bytes of f from offset off (or zeroes if MAP_ANONYMOUS) into
+// the current process.  Returns the address, or -1.
+int
+mmap(uint len, int prot, int flags, struct file *f, uint off)
+{
+  struct proc *p = myproc();
+  struct vma *v, *w;
+  uint end;
+
+  if(len == 0 || len > MMAPTOP || off % PGSIZE)
+    return -1;
+  if(!(flags & MAP_SHARED) == !(flags & MAP_PRIVATE))
+    return -1;
+  if(flags & MAP_ANONYMOUS)
+    f = 0;
+  else if(f == 0 || f->type != FD_INODE || !f->readable ||
+          ((flags & MAP_SHARED) && (prot & PROT_WRITE) && !f->writable))
+    return -1;
+  len = PGROUNDUP(len);
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->start == 0)
+      break;
+  if(v == &p->vma[NVMA])
+    return -1;
+
+  // Highest gap below MMAPTOP that fits, above the heap.
+  end = MMAPTOP;
+again:
+  if(end < len || end - len < PGROUNDUP(p->sz))
+    return -1;
+  for(w = p->vma; w < &p->vma[NVMA]; w++){
+    if(w->start && w->start < end && w->end > end - len){
+      end = w->start;
+      goto again;
+    }
+  }
+
+  v->start = end - len;
+  v->end = end;
+  v->prot = prot;
+  v->flags = flags;
+  v->f = f ? filedup(f) : 0;
+  v->off = off;
+  return v->start;
+}
+
+// Write back to its file the pages of v in [a, b) of p's page table
+// pgdir that may have been written, without growing the file.  Returns -1
+// if there is no memory for the copy.
+static int
+vmaWriteback(struct proc *p, pde_t *pgdir, struct vma *v, uint a, uint b)
+{
+  struct inode *ip = v->f->ip;
+  uint max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  uint va, off, i, n;
+  char *buf;
+
+  if((buf = kalloc()) == 0)
+    return -1;
+  for(va = a; va < b; va += PGSIZE){
+    // Copied out under the paging lock, so that the inode lock is
+    // never taken after it.
+    if(!pageContents(p, pgdir, va, buf))
+      continue;
+    off = v->off + (va - v->start);
+    for(i = 0; i < PGSIZE; i += n){
+      begin_op();
+      ilock(ip);
+      n = 0;
+      if(off + i < ip->size){
+        n = ip->size - (off + i);
+        if(n > PGSIZE - i)
+          n = PGSIZE - i;
+        if(n > max)
+          n = max;
+        writei(ip, buf + i, off + i, n);
+      }
+      iunlock(ip);
+      end_op();
+      if(n == 0)
+        break;
+    }
+  }
+  kfree(buf);
+  return 0;
+}
+
+// Unmap [a, b) of region v of the current process p.
+static int
+vmaUnmap(struct proc *p, struct vma *v, uint a, uint b)
+{
+  if(v->f && (v->flags & MAP_SHARED) && (v->prot & PROT_WRITE))
+    if(vmaWriteback(p, p->pgdir, v, a, b) < 0)
+      return -1;
+  pagingLock();
+  deallocuvm(p->pgdir, b, a);
+  pagingUnlock();
+  switchuvm(p);
+  return 0;
+}
+
+// Unmap the pages of the current process in [addr, addr+len),
+// which may cover parts of several regions.
+int
+munmap(uint addr, uint len)
+{
+  struct proc *p = myproc();
+  struct vma *v, *w, *spare;
+  uint end, a, b;
+
+  end = addr + PGROUNDUP(len);
+  if(addr % PGSIZE || len == 0 || end < addr || end > MMAPTOP)
+    return -1;
+
+  // Unmapping the middle of a region splits it, and needs a slot.
+  spare = 0;
+  for(w = p->vma; w < &p->vma[NVMA]; w++)
+    if(w->start == 0)
+      spare = w;
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->start && v->start < addr && v->end > end && spare == 0)
+      return -1;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->start == 0 || v->end <= addr || v->start >= end)
+      continue;
+    a = v->start > addr ? v->start : addr;
+    b = v->end < end ? v->end : end;
+    if(vmaUnmap(p, v, a, b) < 0)
+      return -1;
+    if(a == v->start && b == v->end){
+      if(v->f)
+        fileclose(v->f);
+      v->start = v->end = 0;
+      v->f = 0;
+    } else if(a == v->start){
+      v->off += b - v->start;
+      v->start = b;
+    } else if(b == v->end){
+      v->end = a;
+    } else {
+      *spare = *v;
+      spare->off += b - v->start;
+      spare->start = b;
+      v->end = a;
+      if(v->f)
+        filedup(v->f);
+    }
+  }
+  return 0;
+}
+
+// Unmap all regions of the current process p, for exit().
+void
+munmapall(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->start == 0)
+      continue;
+    if(vmaUnmap(p, v, v->start, v->end) < 0)
+      cprintf("pid %d %s: no memory to write back a shared mapping\n",
+              p->pid, p->name);
+    if(v->f)
+      fileclose(v->f);
+    v->start = v->end = 0;
+    v->f = 0;
+  }
+}
+
+// Write back and close the regions vma[NVMA] that p had before exec()
+// replaced its page table oldpgdir, which the caller then frees.
+void
+munmapold(struct vma *vma, struct proc *p, pde_t *oldpgdir)
+{
+  struct vma *v;
+
+  for(v = vma; v < &vma[NVMA]; v++){
+    if(v->start == 0)
+      continue;
+    if(v->f && (v->flags & MAP_SHARED) && (v->prot & PROT_WRITE) &&
+       vmaWriteback(p, oldpgdir, v, v->start, v->end) < 0)
+      cprintf("pid %d %s: no memory to write back a shared mapping\n",
+              p->pid, p->name);
+    if(v->f)
+      fileclose(v->f);
+  }
+}
+
+// Map every page of the MAP_SHARED regions of p, before fork()
+// shares them.  Returns -1 if there is no memory for one.
+int
+mmapprefork(struct proc *p)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint va;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->start == 0 || !(v->flags & MAP_SHARED))
+      continue;
+    for(va = v->start; va < v->end; va += PGSIZE){
+      pte = walkpgdir2(p->pgdir, (void*)va);
+      if((pte == 0 || *pte == 0) && demandPage(p, (void*)va) < 0)
+        return -1;
+    }
+  }
+  return 0;
+}
+
+// Give a fork child np the regions of p.  Their pages were copied
+// with the rest of p's memory; those of MAP_SHARED regions now map
+// p's frames instead, and p's are writable again.
+void
+mmapfork(struct proc *p, struct proc *np)
+{
+  struct vma *v;
+  pte_t *pte, *npte;
+  uint va;
+
+  memmove(np->vma, p->vma, sizeof(np->vma));
+  pagingLock();
+  for(v = np->vma; v < &np->vma[NVMA]; v++){
+    if(v->start && v->f)
+      filedup(v->f);
+    if(v->start == 0 || !(v->flags & MAP_SHARED))
+      continue;
+    for(va = v->start; va < v->end; va += PGSIZE){
+      pte = walkpgdir2(p->pgdir, (void*)va);
+      npte = walkpgdir2(np->pgdir, (void*)va);
+      if(pte == 0 || !(*pte & PTE_P) || npte == 0)
+        panic("mmapfork");
+      if(*pte & PTE_COW)
+        *pte = (*pte | PTE_W) & ~PTE_COW;
+      if(PTE_ADDR(*npte) != PTE_ADDR(*pte)){
+        kfree(P2V(PTE_ADDR(*npte)));      // copied by FORK=EAGER
+        kref(P2V(PTE_ADDR(*pte)));
+      }
+      *npte = *pte;
+    }
+  }
+  pagingUnlock();
+  switchuvm(p);
+}
+
+// Advise the pager about the pages of the current process in
+// [addr, addr+len), which must all be user memory.  MADV_RANDOM and
+// MADV_SEQUENTIAL are kept per page (see readAhead() and
+// pageSelector()); MADV_WILLNEED swaps pages in and maps untouched
+// ones while there are resident slots to spare; MADV_DONTNEED drops
+// the pages, without writing them to swap, so that the next touch
+// maps them afresh from their file or zeroed.
+int
+madvise(uint addr, uint len, int advice)
+{
+  struct proc *p = myproc();
+  struct vma *v;
+  uint end, va, a, b;
+  pte_t *pte;
+
+  end = addr + PGROUNDUP(len);
+  if(addr % PGSIZE || len == 0 || end < addr || end > MMAPTOP)
+    return -1;
+  for(va = addr; va < end; va += PGSIZE){
+    if(va >= p->sz && vmaLookup(p, va) == 0)
+      return -1;
+    pte = walkpgdir2(p->pgdir, (void*)va);
+    if(pte && (*pte & PTE_P) && !(*pte & PTE_U))
+      return -1;    // the stack guard page
+  }
+
+  switch(advice){
+  case MADV_NORMAL:
+  case MADV_RANDOM:
+  case MADV_SEQUENTIAL:
+    #ifndef NONE
+    pagingLock();
+    adviseRange(p, addr, end, advice);
+    pagingUnlock();
+    #endif
+    break;
+  case MADV_WILLNEED:
+    #ifndef NONE
+    pagingLock();
+    prefetchRange(p, addr, end);
+    pagingUnlock();
+    #endif
+    for(va = addr; va < end; va += PGSIZE){
+      #ifndef NONE
+      if(p->pim >= p->maxpim)
+        break;
+      #endif
+      pte = walkpgdir2(p->pgdir, (void*)va);
+      if((pte == 0 || *pte == 0) && demandPage(p, (void*)va) < 0)
+        break;
+    }
+    break;
+  case MADV_DONTNEED:
+    for(v = p->vma; v < &p->vma[NVMA]; v++){
+      if(v->start == 0 || v->end <= addr || v->start >= end ||
+         !v->f || !(v->flags & MAP_SHARED) || !(v->prot & PROT_WRITE))
+        continue;
+      a = v->start > addr ? v->start : addr;
+      b = v->end < end ? v->end : end;
+      if(vmaWriteback(p, p->pgdir, v, a, b) < 0)
+        return -1;
+    }
+    pagingLock();
+    deallocuvm(p->pgdir, end, addr);
+    pagingUnlock();
+    switchuvm(p);
+    break;
+  default:
+    return -1;
+  }
+  return 0;
+}
@@ -100,6 +100,8 @@ struct segdesc {
 #define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size
 #define PTE_PG          0x200   // Paged out to secondary storage.
+#define PTE_COW         0x400   // Shared copy-on-write page.
+#define PTE_DZ          0x800   // Paged in on demand; dropped if evicted clean.
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
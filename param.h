@@ -9,7 +9,32 @@
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#ifndef NBUF
+#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache (make NBUF=n)
+#endif
 #define FSSIZE       1000  // size of file system in blocks
-#define MAX_PSYC_PAGES 16 // maximum pages in physical memory per process
-#define MAX_TOTAL_PAGES 32 // maximum pages per process
+#define MAX_PSYC_PAGES 16 // default limit of pages in physical memory per process
+#define MAX_TOTAL_PAGES 32 // default limit of pages per process
+#define MIN_PSYC_PAGES 4  // smallest resident limit (one instruction can touch several pages)
+#define NSWAPSLOTS   1024 // page slots in the swap area after the file system
+#define GCLOCK_FRAMES 64  // user page frames shared by all processes (SELECTION=GCLOCK)
+#define GCLOCK_LOW    4   // the global clock evicts while fewer frames are left
+#define GCLOCK_SPREAD 32  // frames between the global clock's two hands
+#define KSWAPD_LOW    2   // wake the reclaim thread when fewer frames are free
+#define KSWAPD_HIGH   4   // the reclaim thread frees frames up to this many
+#define READAHEAD_MAX 8   // most pages swapped in ahead of a sequential fault
+#define NPCACHE      64   // executable pages shared between processes
+#define PFF_WINDOW   10   // ticks between page fault frequency samples (LIMIT=PFF)
+#define PFF_HIGH      8   // faults per window above which the resident limit grows
+#define PFF_LOW       1   // faults per window below which it shrinks
+#define PFF_STEP      4   // pages it moves by at a time
+#define PFF_MIN       8   // bounds of the resident limit under PFF
+#define PFF_MAX      64
+#define LOAD_WINDOW  10   // ticks between load control samples
+#define LOAD_FAULTS  20   // swap-in faults per window above which, with the
+#define LOAD_UTIL    50   //   CPUs busy less than this percent and frames
+#define LOAD_FREE    8    //   free fewer than this, the system thrashes
+#define LOAD_HOLD    3    // windows a process stays suspended at least
+#define SWAPBATCH    16   // pages written to swap per batch when suspending
+#define PGTRACE_SIZE 256   // page fault trace records per CPU
+#define AGE_PERIOD    1   // ticks of a CPU between aging its process (NFUA, LAPA, AQ)
@@ -0,0 +1,159 @@
+// Executable page cache.
+//
+// Pages demandPage() reads from an executable are kept here, keyed by
+// (dev, inum, file offset, bytes read), so that every process running
+// the same binary maps the same frame copy-on-write instead of reading
+// its own copy.  The cache holds one reference to each frame (kref());
+// an entry whose frame nobody else maps any more is the one recycled
+// when the cache is full.  Writing or truncating a file drops its
+// entries, see writei() and itrunc().
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+
+struct pcentry {
+  uint dev;
+  uint inum;
+  uint off;
+  uint n;
+  char *page;     // 0 if the entry is free
+  uint lastuse;
+};
+
+struct {
+  struct spinlock lock;
+  struct pcentry e[NPCACHE];
+  uint clock;
+} pcache;
+
+void
+pcacheinit(void)
+{
+  initlock(&pcache.lock, "pcache");
+}
+
+static struct pcentry*
+pclookup(struct inode *ip, uint off, uint n)
+{
+  struct pcentry *e;
+
+  for(e = pcache.e; e < &pcache.e[NPCACHE]; e++)
+    if(e->page && e->dev == ip->dev && e->inum == ip->inum &&
+       e->off == off && e->n == n)
+      return e;
+  return 0;
+}
+
+// The cached frame holding the n bytes at off of ip, with a
+// reference added for the caller, or 0.
+char*
+pcacheget(struct inode *ip, uint off, uint n)
+{
+  struct pcentry *e;
+  char *page = 0;
+
+  acquire(&pcache.lock);
+  if((e = pclookup(ip, off, n)) != 0){
+    kref(e->page);
+    e->lastuse = ++pcache.clock;
+    page = e->page;
+  }
+  release(&pcache.lock);
+  return page;
+}
+
+// Offer page, just read with the n bytes at off of ip, to the cache.
+// Returns the frame the caller should map, with a reference added for
+// the caller: page itself, or the frame of an entry another process
+// added meanwhile.  Returns 0 if the cache has no room; page is then
+// the caller's alone.
+char*
+pcacheput(struct inode *ip, uint off, uint n, char *page)
+{
+  struct pcentry *e, *victim;
+  char *old = 0;
+
+  acquire(&pcache.lock);
+  if((e = pclookup(ip, off, n)) != 0){
+    kref(e->page);
+    e->lastuse = ++pcache.clock;
+    page = e->page;
+    goto out;
+  }
+  victim = 0;
+  for(e = pcache.e; e < &pcache.e[NPCACHE]; e++){
+    if(e->page == 0){
+      victim = e;
+      break;
+    }
+    if(krefcount(e->page) == 1 && (victim == 0 || e->lastuse < victim->lastuse))
+      victim = e;
+  }
+  if(victim == 0){
+    page = 0;
+    goto out;
+  }
+  old = victim->page;
+  victim->dev = ip->dev;
+  victim->inum = ip->inum;
+  victim->off = off;
+  victim->n = n;
+  victim->page = page;
+  victim->lastuse = ++pcache.clock;
+  kref(page);
+out:
+  release(&pcache.lock);
+  if(old)
+    kfree(old);
+  return page;
+}
+
+// Drop the cached pages of ip, whose contents are about to change.
+// Processes that map them keep their (now stale) copies.
+void
+pcacheinval(struct inode *ip)
+{
+  struct pcentry *e;
+  char *drop[NPCACHE];
+  int i, n = 0;
+
+  acquire(&pcache.lock);
+  for(e = pcache.e; e < &pcache.e[NPCACHE]; e++){
+    if(e->page && e->dev == ip->dev && e->inum == ip->inum){
+      drop[n++] = e->page;
+      e->page = 0;
+    }
+  }
+  release(&pcache.lock);
+  for(i = 0; i < n; i++)
+    kfree(drop[i]);
+}
+
+// Free the frames only the cache still holds, when memory is short.
+// Returns how many.
+int
+pcachereclaim(void)
+{
+  struct pcentry *e;
+  char *drop[NPCACHE];
+  int i, n = 0;
+
+  acquire(&pcache.lock);
+  for(e = pcache.e; e < &pcache.e[NPCACHE]; e++){
+    if(e->page && krefcount(e->page) == 1){
+      drop[n++] = e->page;
+      e->page = 0;
+    }
+  }
+  release(&pcache.lock);
+  for(i = 0; i < n; i++)
+    kfree(drop[i]);
+  return n;
+}
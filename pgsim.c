@@ -0,0 +1,380 @@
+// pgsim: replay a page fault trace through the replacement policies.
+//
+//   pgsim [-m min] [-M max] [-s step] [log...]
+//
+// Reads the lines pgtrace printed in the xv6 console log (from the
+// files, or standard input) and, for every policy and every resident
+// limit from min to max, replays each process's faults through the
+// kernel's own policy code (policy.c, built for the host along with
+// this file), counting the faults the limit would take.  The page
+// details are kept as in the kernel, PTE_A stands in for references,
+// the aging tick runs once for every tick a process faulted in, and
+// every evicted page leaves a ghost.
+//
+// The kernel only sees a reference when it faults, so the replay is
+// of the faults of the traced run: first touches, swap-ins and
+// copy-on-write faults.  Pages that stayed resident look untouched in
+// between, as they do to the policies in the kernel; trace under a
+// small limit (setpglimit) to capture more of the reference string.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "pgstat.h"
+
+// What policy.c needs of vm.c, as in defs.h.
+int pdSize(struct proc*);
+int pdMoveDown(struct proc*, int);
+void pdRelease(struct proc*, int);
+void exchangePages(struct proc*, int, int);
+void panic(char*) __attribute__((noreturn));
+
+#define NHASH 1024
+
+// A page of a simulated process.  Its PTE lives here, so that the
+// page details can point at it, as in the kernel.
+struct page {
+  uint va;
+  pte_t pte;
+  int pdi;                      // page details entry while resident
+  uint ghost;                   // sp->evicts when evicted, 0 if not a ghost
+  char glist;                   // policy list it was evicted from
+  struct page *next;            // in the same hash bucket
+};
+
+struct sproc {
+  int pid;
+  struct proc p;
+  struct page *hash[NHASH];
+  uint lasttick;                // last tick the aging tick ran for
+  int faults;
+  int refaults;                 // on ghosts less than a limit's worth of evictions old
+};
+
+// A trace record, numbered in the order read.
+struct srec {
+  struct pgtrec r;
+  int seq;
+};
+
+static struct srec *recs;
+static int nrec;
+static struct sproc *procs;
+static int nproc, maxproc;
+
+void
+panic(char *s)
+{
+  fprintf(stderr, "pgsim: %s\n", s);
+  exit(1);
+}
+
+int
+pdSize(struct proc *p)
+{
+  int n;
+
+  if(p->pdt == 0)
+    return 0;
+  n = p->pdt->nchunk * PDCHUNK;
+  return n < p->maxpim ? n : p->maxpim;
+}
+
+// Lowest free page details entry, as pdAlloc() in vm.c.
+static int
+pdAlloc(struct proc *p)
+{
+  struct pdChunk *c;
+  int i, b;
+
+  if(p->pdt == 0 && (p->pdt = calloc(1, sizeof(*p->pdt))) == 0)
+    panic("out of memory");
+  for(i = 0; i < PDDIRSZ && i * PDCHUNK < p->maxpim; i++){
+    if(i == p->pdt->nchunk){
+      if((c = calloc(1, sizeof(*c))) == 0)
+        panic("out of memory");
+      p->pdt->chunk[p->pdt->nchunk++] = c;
+    }
+    c = p->pdt->chunk[i];
+    for(b = 0; b < PDCHUNK && i * PDCHUNK + b < p->maxpim; b++){
+      if(!(c->map[b / 32] & (1 << (b % 32)))){
+        c->map[b / 32] |= 1 << (b % 32);
+        return i * PDCHUNK + b;
+      }
+    }
+  }
+  return -1;
+}
+
+static void
+pdFree(struct proc *p, int i)
+{
+  int b = i % PDCHUNK;
+
+  p->pdt->chunk[i / PDCHUNK]->map[b / 32] &= ~(1 << (b % 32));
+}
+
+void
+pdRelease(struct proc *p, int i)
+{
+  PD(p, i)->inMem = 0;
+  PD(p, i)->va = 0;
+  pdFree(p, i);
+  p->pim--;
+}
+
+int
+pdMoveDown(struct proc *p, int i)
+{
+  int j;
+
+  if((j = pdAlloc(p)) < 0 || j > i)
+    panic("pdMoveDown");
+  *PD(p, j) = *PD(p, i);
+  ((struct page*)PD(p, j)->page)->pdi = j;
+  PD(p, i)->inMem = 0;
+  PD(p, i)->va = 0;
+  pdFree(p, i);
+  return j;
+}
+
+void
+exchangePages(struct proc *p, int i, int j)
+{
+  struct pDet pd;
+
+  pd = *PD(p, i);
+  *PD(p, i) = *PD(p, j);
+  *PD(p, j) = pd;
+  ((struct page*)PD(p, i)->page)->pdi = i;
+  ((struct page*)PD(p, j)->page)->pdi = j;
+}
+
+static struct page*
+lookup(struct sproc *sp, uint va)
+{
+  struct page *pg;
+
+  for(pg = sp->hash[(va >> PTXSHIFT) % NHASH]; pg; pg = pg->next)
+    if(pg->va == va)
+      return pg;
+  if((pg = calloc(1, sizeof(*pg))) == 0)
+    panic("out of memory");
+  pg->va = va;
+  pg->pdi = -1;
+  pg->next = sp->hash[(va >> PTXSHIFT) % NHASH];
+  sp->hash[(va >> PTXSHIFT) % NHASH] = pg;
+  return pg;
+}
+
+static struct sproc*
+findproc(int pid)
+{
+  int i;
+
+  for(i = 0; i < nproc; i++)
+    if(procs[i].pid == pid)
+      return &procs[i];
+  return 0;
+}
+
+// Start every process afresh under policy pol and resident limit max.
+static void
+reset(struct pgpolicy *pol, int max)
+{
+  struct sproc *sp;
+  struct page *pg, *next;
+  int i, pid;
+
+  for(sp = procs; sp < &procs[nproc]; sp++){
+    for(i = 0; i < NHASH; i++){
+      for(pg = sp->hash[i]; pg; pg = next){
+        next = pg->next;
+        free(pg);
+      }
+    }
+    if(sp->p.pdt){
+      for(i = 0; i < sp->p.pdt->nchunk; i++)
+        free(sp->p.pdt->chunk[i]);
+      free(sp->p.pdt);
+    }
+    pid = sp->pid;
+    memset(sp, 0, sizeof(*sp));
+    sp->pid = pid;
+    sp->p.maxpim = max;
+    sp->p.policy = pol;
+    sp->lasttick = ~0;
+  }
+}
+
+// A fault of sp on page va at tick, as trap() and swapAndRead() would
+// take it.
+static void
+reference(struct sproc *sp, uint va, uint tick)
+{
+  struct proc *p = &sp->p;
+  struct page *pg, *out;
+  uint dist;
+  int i;
+
+  if(p->policy->tick && sp->lasttick != tick && p->pdt){
+    p->policy->tick(p);
+    sp->lasttick = tick;
+  }
+  pg = lookup(sp, va);
+  if(pg->pdi >= 0){
+    pg->pte |= PTE_A;
+    return;
+  }
+  sp->faults++;
+  if(p->pim == p->maxpim){
+    if((i = p->policy->victim(p)) < 0 || i >= pdSize(p) || !PD(p, i)->inMem)
+      panic("no page to evict");
+    out = PD(p, i)->page;
+    out->ghost = ++p->evicts;
+    out->glist = PD(p, i)->list;
+    p->policy->remove(p, i);
+    out->pdi = -1;
+    out->pte = 0;
+  }
+  if((i = pdAlloc(p)) < 0)
+    panic("no page details entry");
+  memset(PD(p, i), 0, sizeof(struct pDet));
+  PD(p, i)->inMem = 1;
+  PD(p, i)->va = (void*)(unsigned long)va;
+  PD(p, i)->pte = &pg->pte;
+  PD(p, i)->page = pg;
+  PD(p, i)->sdi = -1;
+  pg->pdi = i;
+  pg->pte = PTE_P | PTE_U | PTE_A;
+  p->pim++;
+  p->policy->insert(p, i);
+  if(pg->ghost){
+    dist = p->evicts - pg->ghost;
+    if(dist < p->maxpim)
+      sp->refaults++;
+    if(p->policy->refault)
+      p->policy->refault(p, pg->pdi, pg->glist, dist);
+    pg->ghost = 0;
+  }
+}
+
+static void
+readtrace(FILE *f)
+{
+  char line[512], *s, type;
+  struct pgtrec r;
+  static int max;
+
+  while(fgets(line, sizeof(line), f)){
+    if((s = strstr(line, "pgt ")) == 0)
+      continue;
+    if(sscanf(s, "pgt %u %d %c %x", &r.tick, &r.pid, &type, &r.va) != 4)
+      continue;
+    r.va &= ~0xfff;
+    r.va |= type == 'f' ? PGT_FAULT : type == 'e' ? PGT_EVICT : PGT_SWAPIN;
+    if(nrec == max){
+      max = max ? 2 * max : 4096;
+      if((recs = realloc(recs, max * sizeof(*recs))) == 0)
+        panic("out of memory");
+    }
+    recs[nrec].r = r;
+    recs[nrec].seq = nrec;
+    nrec++;
+  }
+}
+
+// By tick, and in the order read within a tick.
+static int
+bytick(const void *a, const void *b)
+{
+  const struct srec *x = a, *y = b;
+
+  if(x->r.tick != y->r.tick)
+    return x->r.tick < y->r.tick ? -1 : 1;
+  return x->seq - y->seq;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int min = MIN_PSYC_PAGES, max = MAX_TOTAL_PAGES, step = 2;
+  int i, j, m, n[4], faults, refaults;
+  struct sproc *sp;
+  FILE *f;
+
+  for(i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2){
+    if(strcmp(argv[i], "-m") == 0)
+      min = atoi(argv[i + 1]);
+    else if(strcmp(argv[i], "-M") == 0)
+      max = atoi(argv[i + 1]);
+    else if(strcmp(argv[i], "-s") == 0)
+      step = atoi(argv[i + 1]);
+    else
+      break;
+  }
+  if(min < 1 || max < min || step < 1){
+    fprintf(stderr, "usage: pgsim [-m min] [-M max] [-s step] [log...]\n");
+    return 1;
+  }
+  if(i == argc)
+    readtrace(stdin);
+  for(; i < argc; i++){
+    if((f = fopen(argv[i], "r")) == 0){
+      perror(argv[i]);
+      return 1;
+    }
+    readtrace(f);
+    fclose(f);
+  }
+  if(nrec == 0){
+    fprintf(stderr, "pgsim: no pgt records\n");
+    return 1;
+  }
+  qsort(recs, nrec, sizeof(*recs), bytick);
+
+  memset(n, 0, sizeof(n));
+  for(i = 0; i < nrec; i++){
+    n[PGT_TYPE(&recs[i].r)]++;
+    if(findproc(recs[i].r.pid))
+      continue;
+    if(nproc == maxproc){
+      maxproc = maxproc ? 2 * maxproc : 16;
+      if((procs = realloc(procs, maxproc * sizeof(*procs))) == 0)
+        panic("out of memory");
+    }
+    memset(&procs[nproc], 0, sizeof(*procs));
+    procs[nproc++].pid = recs[i].r.pid;
+  }
+  printf("trace: %d processes, ticks %u-%u: %d faults, %d evictions, %d swap-ins\n",
+    nproc, recs[0].r.tick, recs[nrec - 1].r.tick, n[PGT_FAULT], n[PGT_EVICT], n[PGT_SWAPIN]);
+
+  printf("%-9s", "limit");
+  for(j = 0; j < NPOLICY; j++)
+    printf(" %15s", policies[j].name);
+  printf("\n");
+  for(m = min; m <= max; m += step){
+    printf("%-9d", m);
+    for(j = 0; j < NPOLICY; j++){
+      reset(&policies[j], m);
+      for(i = 0; i < nrec; i++)
+        if(PGT_TYPE(&recs[i].r) == PGT_FAULT)
+          reference(findproc(recs[i].r.pid), PGT_VA(&recs[i].r), recs[i].r.tick);
+      faults = refaults = 0;
+      for(sp = procs; sp < &procs[nproc]; sp++){
+        faults += sp->faults;
+        refaults += sp->refaults;
+      }
+      printf(" %8d/%-6d", faults, refaults);
+    }
+    printf("\n");
+  }
+  printf("(faults/refaults on pages evicted less than a limit's worth of evictions before)\n");
+  return 0;
+}
@@ -0,0 +1,77 @@
+// Page replacement policies, for setpolicy().
+#define POLICY_SCFIFO 0
+#define POLICY_NFUA   1
+#define POLICY_LAPA   2
+#define POLICY_AQ     3
+#define POLICY_ARC    4
+#define POLICY_CLOCKPRO 5
+#define POLICY_2Q     6
+#define NPOLICY       7
+
+// Paging counters of the calling process, filled in by pgstat().
+struct pgstat {
+  int pim;  // pages in memory
+  int sp;   // swapped out pages
+  int ts;   // total number of paged out pages
+  int pf;   // page faults
+  int cd;   // clean pages dropped without writing
+  int df;   // pages faulted in from the executable or zeroed
+  int sh;   // of those, mapped shared from the page cache
+  int ra;   // pages swapped in ahead of a fault
+  int rw;   // of those, evicted before being used
+  int maxpim; // limit of pages in memory
+  int maxsp;  // limit of swapped out pages
+  int policy; // replacement policy (POLICY_)
+  int gh;     // swap-in faults on pages evicted maxpim evictions ago at most
+};
+
+// Buffer cache counters, filled in by bcstat().
+struct bcstat {
+  int nbuf;       // buffers in the cache
+  int hits;       // lookups that found the block cached
+  int misses;     // lookups that had to recycle a buffer
+  int contended;  // bucket lock acquires that found it held
+};
+
+// Load control state, filled in by loadctl().
+struct loadstat {
+  int on;         // suspending processes when the system thrashes
+  int windows;    // samples taken
+  int thrashing;  // of those, that found the system thrashing
+  int suspends;   // processes suspended
+  int resumes;    // processes resumed
+  int suspended;  // processes suspended now
+  int pages;      // pages written out suspending them
+};
+
+// Page aging sampler counters, filled in by agestat().
+struct agestat {
+  int samples;    // processes aged
+  int pages;      // pages they had resident
+  int deferred;   // samples put off because the process was in the kernel
+  int kcycles;    // time it took, in units of 1024 CPU cycles
+};
+
+// Page fault trace records, drained by pgtrace() and replayed by the
+// pgsim host tool.  va is a page address, with the type in its low bits.
+#define PGT_FAULT   1   // page fault at va, in user mode
+#define PGT_EVICT   2   // page at va written to swap or dropped
+#define PGT_SWAPIN  3   // page at va read back from swap
+#define PGT_TYPE(r)  ((r)->va & 0xfff)
+#define PGT_VA(r)    ((r)->va & ~0xfff)
+
+struct pgtrec {
+  uint tick;      // when
+  uint va;        // page address | PGT_ type
+  int pid;        // whose page
+};
+
+// System wide swap I/O counters, filled in by swapstat().
+struct swapstat {
+  int idereqs;  // requests issued to the IDE disk
+  int idesecs;  // sectors they moved
+  int outs;     // pages written to the swap area
+  int ins;      // pages read from the swap area
+  int ticks;    // ticks spent waiting for swap I/O
+  int free;     // frames free now
+};
@@ -0,0 +1,85 @@
+// pgtrace: run a command with the page fault trace on, and print the
+// trace, one record per line:
+//   pgt <tick> <pid> <f|e|s> <va>
+// for a fault, an eviction and a swap-in; va in hex.  Each line goes
+// out in one write, so the command's output may come between lines
+// but not into them.  Feed the console log to pgsim on the host.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "pgstat.h"
+
+#define NREC 64
+
+static char*
+putnum(char *s, uint x, int base)
+{
+  char tmp[16];
+  int i = 0;
+
+  do {
+    tmp[i++] = "0123456789abcdef"[x % base];
+  } while((x /= base) != 0);
+  while(i > 0)
+    *s++ = tmp[--i];
+  return s;
+}
+
+// Drain the trace and print it until it is off and empty.
+static void
+drain(void)
+{
+  static struct pgtrec buf[NREC];
+  char line[48], *s;
+  int i, n, lost;
+
+  while((n = pgtrace(-1, buf, NREC, &lost)) >= 0){
+    if(lost > 0)
+      printf(2, "pgtrace: %d records lost\n", lost);
+    for(i = 0; i < n; i++){
+      s = line;
+      memmove(s, "pgt ", 4);
+      s = putnum(s + 4, buf[i].tick, 10);
+      *s++ = ' ';
+      s = putnum(s, buf[i].pid, 10);
+      *s++ = ' ';
+      *s++ = " fes"[PGT_TYPE(&buf[i])];
+      *s++ = ' ';
+      s = putnum(s, PGT_VA(&buf[i]), 16);
+      *s++ = '\n';
+      write(1, line, s - line);
+    }
+    if(n < NREC)
+      sleep(1);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid, drainer, w, lost;
+
+  if(argc < 2){
+    printf(2, "usage: pgtrace command [arg...]\n");
+    exit();
+  }
+  if(pgtrace(1, 0, 0, &lost) < 0){
+    printf(2, "pgtrace: cannot trace\n");
+    exit();
+  }
+  if((drainer = fork()) == 0){
+    drain();
+    exit();
+  }
+  if((pid = fork()) == 0){
+    exec(argv[1], argv + 1);
+    printf(2, "pgtrace: exec %s failed\n", argv[1]);
+    exit();
+  }
+  while((w = wait()) != pid && w >= 0)
+    ;
+  pgtrace(0, 0, 0, &lost);
+  wait();
+  exit();
+}
@@ -0,0 +1,535 @@
+// Page replacement policies.
+//
+// Every process pages with one of the policies below, chosen at run
+// time.  New processes take the system default, which SELECTION in
+// the Makefile picks at boot (SCFIFO under GCLOCK); fork children
+// take their parent's; setpolicy() switches one process or all of
+// them.  A policy sees the page details of a process through:
+//   victim  the resident page to evict next
+//   insert  entry i was just filled in for a page made resident
+//   remove  entry i leaves memory; the policy frees it
+//   tick    the page aging sampler caught the process running (age.c),
+//           0 if the policy does not age pages
+//   adopt   convert what the previous policy left in the entries
+//   refault a swap-in fault hit a page it evicted (see ARC below),
+//           0 if the policy does not keep ghosts
+// All but tick run with the paging lock held.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "pgstat.h"
+
+// Entries NFUA and LAPA fill the aging counter with, and the rest
+// leave unused: a page inserted by LAPA has not lost any references
+// yet.
+static void
+nfuaInsert(struct proc *p, int i)
+{
+  PD(p, i)->accCount = 0;
+}
+
+static void
+lapaInsert(struct proc *p, int i)
+{
+  PD(p, i)->accCount = 0xffffffff;
+}
+
+static void
+noInsert(struct proc *p, int i)
+{
+}
+
+// NFU + AGING
+// Find the page that is 'accCount' var is the lowest.
+static int
+nfuaVictim(struct proc *p)
+{
+  int i, ans = -1;
+  uint lowest = 0xffffffff;
+
+  for(i = 0; i < pdSize(p); i++){
+    if(!PD(p, i)->inMem || !(*PD(p, i)->pte & PTE_U))
+      continue;
+    if(PD(p, i)->accCount <= lowest){
+      lowest = PD(p, i)->accCount;
+      ans = i;
+    }
+  }
+  return ans;
+}
+
+// Leaset accesed page + AGING
+// Find the page with the lowest 1's in 'accCount',
+// if the number of 1 in 'accCount' is equale, then take the the lowest 'accCount'
+static int
+lapaVictim(struct proc *p)
+{
+  int i, ans = -1;
+  uint ones, minones = 33, lowest = 0xffffffff, acc;
+
+  for(i = 0; i < pdSize(p); i++){
+    if(!PD(p, i)->inMem || !(*PD(p, i)->pte & PTE_U))
+      continue;
+    ones = 0;
+    for(acc = PD(p, i)->accCount; acc; acc >>= 1)
+      ones += acc & 1;
+    if(ones < minones || (ones == minones && PD(p, i)->accCount <= lowest)){
+      lowest = PD(p, i)->accCount;
+      minones = ones;
+      ans = i;
+    }
+  }
+  return ans;
+}
+
+// Second chance FIFO
+// Find the first page (FIFO) from the hand whose PTE_A is 0,
+// clearing PTE_A of the pages passed.
+static int
+scfifoVictim(struct proc *p)
+{
+  pte_t *pte;
+  int accessed = 1;
+
+  while(accessed){
+    if(p->head >= pdSize(p))
+      p->head = 0;
+    if(!PD(p, p->head)->inMem || !(*PD(p, p->head)->pte & PTE_U)){
+      p->head++;
+      continue;
+    }
+    pte = PD(p, p->head)->pte;
+    accessed = *pte & PTE_A;
+    *pte &= ~PTE_A;
+    p->head++;
+  }
+  //the first page that wasn't accessed (we go back -1 because of the loop)
+  return p->head - 1;
+}
+
+// Advancing Queue
+// The resident pages are kept in entries 0..pim-1; the front one
+// goes first.
+static int
+aqVictim(struct proc *p)
+{
+  int i;
+
+  for(i = 0; i < p->pim; i++)
+    if(!PD(p, i)->inMem)
+      panic("aqVictim: page not in memory");
+  for(i = 0; i < p->pim; i++)
+    if(*PD(p, i)->pte & PTE_U)
+      break;
+  return i;
+}
+
+static void
+anyRemove(struct proc *p, int i)
+{
+  pdRelease(p, i);
+}
+
+// Close the gap in the queue.
+static void
+aqRemove(struct proc *p, int i)
+{
+  if(i >= p->pim)
+    panic("aqRemove: index is illegal");
+  for(; i < p->pim - 1; i++){
+    if(!PD(p, i + 1)->inMem)
+      panic("aqRemove: page not in memory");
+    exchangePages(p, i, i + 1);
+  }
+  pdRelease(p, i);
+}
+
+// Shift each page's aging counter right and put PTE_A in at the top.
+static void
+agingTick(struct proc *p)
+{
+  int i;
+  pte_t *pte;
+
+  for(i = 0; i < pdSize(p); i++){
+    if(!PD(p, i)->inMem)
+      continue;
+    pte = PD(p, i)->pte;
+    PD(p, i)->accCount >>= 1;
+    if(*pte & PTE_A){
+      PD(p, i)->accCount |= 0x80000000;
+      *pte &= ~PTE_A;
+    }
+  }
+}
+
+// A page referenced since the last sample advances past an
+// unreferenced one in front of it.
+static void
+aqTick(struct proc *p)
+{
+  int i;
+  pte_t *pte1, *pte2;
+
+  for(i = p->pim - 1; i > 0; i--){
+    if(!PD(p, i)->inMem || !PD(p, i - 1)->inMem)
+      panic("aqTick: page not in memory");
+    pte1 = PD(p, i)->pte;
+    pte2 = PD(p, i - 1)->pte;
+    if((*pte1 & PTE_A) && (*pte2 & PTE_A)){
+      *pte1 &= ~PTE_A;
+    } else if(!(*pte1 & PTE_A) && (*pte2 & PTE_A)){
+      exchangePages(p, i, i - 1);
+      *pte2 &= ~PTE_A;
+    }
+  }
+}
+
+// Start the aging counters from PTE_A, unless the previous policy
+// kept them too.
+static void
+agingAdopt(struct proc *p, struct pgpolicy *old)
+{
+  int i;
+
+  if(old->tick == agingTick)
+    return;
+  for(i = 0; i < pdSize(p); i++)
+    if(PD(p, i)->inMem)
+      PD(p, i)->accCount = (*PD(p, i)->pte & PTE_A) ? 0x80000000 : 0;
+}
+
+// The hand starts over.
+static void
+scfifoAdopt(struct proc *p, struct pgpolicy *old)
+{
+  p->head = 0;
+}
+
+// Pack the resident pages into entries 0..pim-1, in the order old
+// would have evicted them: from the hand for SCFIFO, by aging counter
+// for NFUA and LAPA.
+static void
+aqAdopt(struct proc *p, struct pgpolicy *old)
+{
+  int i, j, min, n = pdSize(p);
+
+  if(old->victim == scfifoVictim)
+    for(i = 0; i < n; i++)
+      PD(p, i)->accCount = (i - p->head + n) % n;
+  for(i = n - 1; i >= p->pim; i--)
+    if(PD(p, i)->inMem)
+      pdMoveDown(p, i);
+  for(i = 0; i < p->pim; i++){
+    min = i;
+    for(j = i + 1; j < p->pim; j++)
+      if(PD(p, j)->accCount < PD(p, min)->accCount)
+        min = j;
+    if(min != i)
+      exchangePages(p, i, min);
+  }
+}
+
+// ARC, CLOCK-Pro and 2Q keep each resident page on one of a few
+// lists (its list field, counted in p->nlist) and learn from the
+// pages they evicted: swapOut() leaves a ghost in the swap details,
+// the list the page was on stamped with p->evicts, and a swap-in fault
+// on it calls the refault hook with the evictions since.  A ghost more
+// than maxpim evictions old stands for one that has fallen off the
+// textbook ghost lists; as their lengths are not kept, a hit moves a
+// target by one page.  References are seen through PTE_A, so the LRU
+// lists become clocks, as in CAR and CLOCK-Pro.  Pages dropped rather
+// than swapped (never written, or clean file pages) leave no ghost.
+
+static void
+listInsert(struct proc *p, int i, int l)
+{
+  PD(p, i)->list = l;
+  PD(p, i)->accCount = p->stamp++;
+  p->nlist[l]++;
+}
+
+static void
+listMove(struct proc *p, int i, int l)
+{
+  p->nlist[(int)PD(p, i)->list]--;
+  PD(p, i)->list = l;
+  p->nlist[l]++;
+}
+
+static void
+listRemove(struct proc *p, int i)
+{
+  p->nlist[(int)PD(p, i)->list]--;
+  pdRelease(p, i);
+}
+
+// Put the resident pages referenced lately on list hot and the rest
+// on list cold.
+static void
+listAdopt(struct proc *p, int cold, int hot)
+{
+  int i;
+
+  memset(p->hand, 0, sizeof(p->hand));
+  memset(p->nlist, 0, sizeof(p->nlist));
+  p->target = 0;
+  for(i = 0; i < pdSize(p); i++)
+    if(PD(p, i)->inMem)
+      listInsert(p, i, (*PD(p, i)->pte & PTE_A) ? hot : cold);
+}
+
+// Advance clock hand h to the next resident user page on one of the
+// lists in mask, and return it; -1 if a turn finds none.
+static int
+clockNext(struct proc *p, int h, int mask)
+{
+  int i, e, n = pdSize(p);
+
+  for(i = 0; i < n; i++){
+    if(p->hand[h] >= n)
+      p->hand[h] = 0;
+    e = p->hand[h]++;
+    if(PD(p, e)->inMem && (mask & (1 << PD(p, e)->list)) && (*PD(p, e)->pte & PTE_U))
+      return e;
+  }
+  return -1;
+}
+
+// Adaptive Replacement Cache, with clocks (CAR)
+// T1 holds the pages used once since they were faulted in, T2 the
+// ones used again; target is the size ARC aims T1 at.
+#define ARC_T1  1
+#define ARC_T2  2
+
+static void
+arcInsert(struct proc *p, int i)
+{
+  listInsert(p, i, ARC_T1);
+}
+
+// Take from T1 while it is over target, else from T2.  T1's hand
+// moves the referenced pages it passes to T2, T2's gives them a second
+// chance.
+static int
+arcVictim(struct proc *p)
+{
+  int i, l;
+  pte_t *pte;
+
+  for(;;){
+    l = p->nlist[ARC_T1] >= (p->target > 1 ? p->target : 1) ? ARC_T1 : ARC_T2;
+    if((i = clockNext(p, l - 1, 1 << l)) < 0){
+      l = ARC_T1 + ARC_T2 - l;
+      if((i = clockNext(p, l - 1, 1 << l)) < 0)
+        return -1;
+    }
+    pte = PD(p, i)->pte;
+    if(!(*pte & PTE_A))
+      return i;
+    *pte &= ~PTE_A;
+    if(l == ARC_T1)
+      listMove(p, i, ARC_T2);
+  }
+}
+
+// A ghost from T1 (B1) asks for a longer T1, one from T2 (B2) for a
+// shorter one.  The page was used again either way: on to T2.
+static void
+arcRefault(struct proc *p, int i, int glist, uint dist)
+{
+  if(dist >= p->maxpim)
+    return;
+  if(glist == ARC_T1 && p->target < p->maxpim)
+    p->target++;
+  else if(glist == ARC_T2 && p->target > 0)
+    p->target--;
+  listMove(p, i, ARC_T2);
+}
+
+static void
+arcAdopt(struct proc *p, struct pgpolicy *old)
+{
+  listAdopt(p, ARC_T1, ARC_T2);
+}
+
+// CLOCK-Pro
+// Cold pages are the candidates for eviction.  A page faulted in
+// starts cold and in its test period; used again within it (resident,
+// or as a ghost, up to maxpim evictions later) it turns hot.  The hot
+// hand keeps the hot pages down to maxpim - target - 1, turning the
+// ones not used since it last passed cold, and ends the test periods
+// of the unused cold pages it passes.  A ghost hit in its test period
+// raises target, the cold share; a test period run out lowers it.
+#define CP_COLD 1
+#define CP_HOT  2
+#define CP_TEST 3       // cold, in its test period
+
+static void
+cpInsert(struct proc *p, int i)
+{
+  listInsert(p, i, CP_TEST);
+}
+
+static void
+cpHotHand(struct proc *p)
+{
+  int i, n;
+  pte_t *pte;
+
+  for(n = 2 * pdSize(p); n > 0 && p->nlist[CP_HOT] > p->maxpim - p->target - 1; n--){
+    if((i = clockNext(p, 1, 1 << CP_HOT | 1 << CP_TEST)) < 0)
+      return;
+    pte = PD(p, i)->pte;
+    if(PD(p, i)->list == CP_TEST){
+      if(!(*pte & PTE_A)){
+        listMove(p, i, CP_COLD);
+        if(p->target > 0)
+          p->target--;
+      }
+    } else if(*pte & PTE_A)
+      *pte &= ~PTE_A;
+    else
+      listMove(p, i, CP_COLD);
+  }
+}
+
+static int
+cpVictim(struct proc *p)
+{
+  int i;
+  pte_t *pte;
+
+  for(;;){
+    cpHotHand(p);
+    if((i = clockNext(p, 0, 1 << CP_COLD | 1 << CP_TEST)) < 0 &&
+       (i = clockNext(p, 1, 1 << CP_HOT)) < 0)
+      return -1;
+    pte = PD(p, i)->pte;
+    if(!(*pte & PTE_A))
+      return i;
+    *pte &= ~PTE_A;
+    if(PD(p, i)->list == CP_TEST)
+      listMove(p, i, CP_HOT);
+    else if(PD(p, i)->list == CP_COLD)
+      listMove(p, i, CP_TEST);
+  }
+}
+
+static void
+cpRefault(struct proc *p, int i, int glist, uint dist)
+{
+  if(glist != CP_TEST || dist >= p->maxpim)
+    return;
+  if(p->target < p->maxpim - 1)
+    p->target++;
+  listMove(p, i, CP_HOT);
+}
+
+static void
+cpAdopt(struct proc *p, struct pgpolicy *old)
+{
+  listAdopt(p, CP_TEST, CP_HOT);
+}
+
+// 2Q
+// A1in takes the pages faulted in, first in first out, up to a quarter
+// of the resident limit.  A page faulted in again while its ghost is
+// on A1out (evicted from A1in at most maxpim / 2 evictions ago) goes
+// on Am, which a clock keeps.  A page used again while still on A1in
+// stays there: one burst of references is not reuse.
+#define Q2_A1   1
+#define Q2_AM   2
+
+static void
+q2Insert(struct proc *p, int i)
+{
+  listInsert(p, i, Q2_A1);
+}
+
+// The oldest resident user page on A1in, or -1.
+static int
+q2Oldest(struct proc *p)
+{
+  int i, ans = -1;
+
+  for(i = 0; i < pdSize(p); i++){
+    if(!PD(p, i)->inMem || PD(p, i)->list != Q2_A1 || !(*PD(p, i)->pte & PTE_U))
+      continue;
+    if(ans < 0 || p->stamp - PD(p, i)->accCount > p->stamp - PD(p, ans)->accCount)
+      ans = i;
+  }
+  return ans;
+}
+
+static int
+q2Victim(struct proc *p)
+{
+  int i;
+  pte_t *pte;
+
+  if(p->nlist[Q2_A1] > p->maxpim / 4 && (i = q2Oldest(p)) >= 0)
+    return i;
+  while((i = clockNext(p, 0, 1 << Q2_AM)) >= 0){
+    pte = PD(p, i)->pte;
+    if(!(*pte & PTE_A))
+      return i;
+    *pte &= ~PTE_A;
+  }
+  return q2Oldest(p);
+}
+
+static void
+q2Refault(struct proc *p, int i, int glist, uint dist)
+{
+  if(glist == Q2_A1 && dist < p->maxpim / 2)
+    listMove(p, i, Q2_AM);
+}
+
+static void
+q2Adopt(struct proc *p, struct pgpolicy *old)
+{
+  listAdopt(p, Q2_A1, Q2_AM);
+}
+
+struct pgpolicy policies[NPOLICY] = {
+[POLICY_SCFIFO] {POLICY_SCFIFO, "SCFIFO", scfifoVictim, noInsert, anyRemove, 0, scfifoAdopt, 0},
+[POLICY_NFUA]   {POLICY_NFUA, "NFUA", nfuaVictim, nfuaInsert, anyRemove, agingTick, agingAdopt, 0},
+[POLICY_LAPA]   {POLICY_LAPA, "LAPA", lapaVictim, lapaInsert, anyRemove, agingTick, agingAdopt, 0},
+[POLICY_AQ]     {POLICY_AQ, "AQ", aqVictim, noInsert, aqRemove, aqTick, aqAdopt, 0},
+[POLICY_ARC]    {POLICY_ARC, "ARC", arcVictim, arcInsert, listRemove, 0, arcAdopt, arcRefault},
+[POLICY_CLOCKPRO] {POLICY_CLOCKPRO, "CLOCKPRO", cpVictim, cpInsert, listRemove, 0, cpAdopt, cpRefault},
+[POLICY_2Q]     {POLICY_2Q, "2Q", q2Victim, q2Insert, listRemove, 0, q2Adopt, q2Refault},
+};
+
+#if defined(NFUA)
+struct pgpolicy *defpolicy = &policies[POLICY_NFUA];
+#elif defined(LAPA)
+struct pgpolicy *defpolicy = &policies[POLICY_LAPA];
+#elif defined(AQ)
+struct pgpolicy *defpolicy = &policies[POLICY_AQ];
+#elif defined(ARC)
+struct pgpolicy *defpolicy = &policies[POLICY_ARC];
+#elif defined(CLOCKPRO)
+struct pgpolicy *defpolicy = &policies[POLICY_CLOCKPRO];
+#elif defined(TWOQ)
+struct pgpolicy *defpolicy = &policies[POLICY_2Q];
+#else
+struct pgpolicy *defpolicy = &policies[POLICY_SCFIFO];
+#endif
+
+// Move p to policy pol.  Called with the paging lock held; p must
+// not be running, unless it is the caller.
+void
+policyswitch(struct proc *p, struct pgpolicy *pol)
+{
+  if(p->policy == pol)
+    return;
+  if(p->pdt)
+    pol->adopt(p, p->policy);
+  p->policy = pol;
+}
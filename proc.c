@@ -6,8 +6,8 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "pgstat.h"
 
-void updatePageingFrameWork();
 struct {
   struct spinlock lock;
   struct proc proc[NPROC];
@@ -19,11 +19,29 @@ int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
-extern int freePages;
 extern int totalFreePages;
 
 static void wakeup1(void *chan);
 
+// Page reclaim thread (see kswapd()).
+struct {
+  int wanted;                   // some process is short of frames
+  int passes;                   // reclaim passes run
+  int pages;                    // pages it wrote to swap
+  int pffdue;                   // a page fault frequency window ended
+  int pffgrown, pffshrunk;      // resident limits it moved
+  int loaddue;                  // a load control window ended
+} kswapdstat;
+
+// Load control (see loadControl()), run by the reclaim thread.
+struct {
+  int on;
+  int windows, thrashing;       // samples taken, and found thrashing
+  int suspends, resumes;
+  int pages;                    // pages written out suspending processes
+  uint faults, busy, idle;      // counters at the last sample
+} swapper;
+
 void
 pinit(void)
 {
@@ -92,6 +110,11 @@ allocproc(void)
 found:
   p->state = EMBRYO;
   p->pid = nextpid++;
+  p->exe = 0;
+  p->nseg = 0;
+  p->suspended = 0;
+  p->loadmark = 0;
+  memset(p->vma, 0, sizeof(p->vma));
 
   release(&ptable.lock);
 
@@ -117,16 +140,17 @@ found:
   p->context->eip = (uint)forkret;
   
   #ifndef NONE
-  p->pim = 0;
-  p->sp = 0;
-  p->ts = 0;
-  p->pf = 0;
-  p->head = 0;
-
-  for(int i = 0 ; i < MAX_PSYC_PAGES ; i++){
-    p->sd[i].inSF = 0;
-    p->pd[i].inMem = 0;
-  }
+  #ifdef GCLOCK
+  p->maxpim = GCLOCK_FRAMES;
+  #else
+  p->maxpim = MAX_PSYC_PAGES;
+  #endif
+  p->maxsp = MAX_TOTAL_PAGES - MAX_PSYC_PAGES;
+  p->pinned = 0;
+  p->policy = defpolicy;
+  p->pdt = 0;
+  p->sdt = 0;
+  initPageDetails(p);
   #endif
 
   return p;
@@ -170,6 +194,357 @@ userinit(void)
   release(&ptable.lock);
 }
 
+#ifndef NONE
+static void kswapd(void);
+
+// Whether the paging code may take pages of p other than its own
+// faults do: a user process (not init or the shell) that is not being
+// paged already, and is off the CPUs or the caller.  It may be asleep
+// in a system call, or preempted in one: the kernel never touches
+// user memory holding a spinlock (see pipewrite()), so faulting the
+// pages back in can sleep.  Called with ptable.lock held.
+static int
+pageable(struct proc *p)
+{
+  if(p->state != RUNNABLE && p->state != SLEEPING && p != myproc())
+    return 0;
+  if(p->evicting || p->sz == 0)
+    return 0;
+  return strncmp(p->name,"init",4) && strncmp(p->name,"sh",2);
+}
+
+// Start the page reclaim thread, a process with no user
+// memory that runs kswapd() in the kernel.
+void
+kswapdinit(void)
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0 || (p->pgdir = setupkvm()) == 0)
+    panic("kswapdinit");
+  p->context->eip = (uint)kswapd;
+  safestrcpy(p->name, "kswapd", sizeof(p->name));
+  swapper.on = 1;
+
+  acquire(&ptable.lock);
+  p->state = RUNNABLE;
+  release(&ptable.lock);
+}
+
+// Ask the reclaim thread for a pass.
+void
+kswapdWake(void)
+{
+  acquire(&ptable.lock);
+  kswapdstat.wanted = 1;
+  wakeup1(&kswapdstat);
+  release(&ptable.lock);
+}
+
+// End of a load control window, from the timer interrupt.
+void
+loadWake(void)
+{
+  acquire(&ptable.lock);
+  kswapdstat.loaddue = 1;
+  wakeup1(&kswapdstat);
+  release(&ptable.lock);
+}
+
+// Load control: the medium term scheduler of classic Unix.  The
+// system thrashes if in the last LOAD_WINDOW more than LOAD_FAULTS
+// faults had to swap a page in while the CPUs were busy less than
+// LOAD_UTIL percent of the time and fewer than LOAD_FREE frames were
+// free, that is, processes are waiting on the disk for each other's
+// frames.  With per-process limits that only happens when memory runs
+// out; under GCLOCK the processes share GCLOCK_FRAMES.  Then, as long
+// as another process is left faulting, the newest one faulting (the
+// highest pid, the last admitted, if pageable(): asleep in a system
+// call will do) is suspended: held off the CPUs while its whole
+// resident set is written to swap in batches, so the others get its
+// frames.  One process is resumed per window, the one suspended
+// first, once nothing else is left to run, or once the system has
+// stopped thrashing and it has been out LOAD_HOLD windows; the pages
+// it was suspended with are swapped back in together.
+// Called with the paging lock held.
+static void
+loadControl(void)
+{
+  struct proc *p, *victim, *resume;
+  uint busy, idle, faults;
+  int i, thrashing, faulting, running;
+
+  busy = idle = 0;
+  for(i = 0; i < ncpu; i++){
+    busy += cpus[i].busy;
+    idle += cpus[i].idle;
+  }
+  faults = swapfaults - swapper.faults;
+  swapper.faults = swapfaults;
+  busy -= swapper.busy;
+  swapper.busy += busy;
+  idle -= swapper.idle;
+  swapper.idle += idle;
+  thrashing = faults > LOAD_FAULTS && busy * 100 < LOAD_UTIL * (busy + idle) &&
+              kfreeframes() < LOAD_FREE;
+
+  acquire(&ptable.lock);
+  swapper.windows++;
+  swapper.thrashing += thrashing;
+  victim = resume = 0;
+  faulting = running = 0;
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->state == UNUSED || p->state == EMBRYO || p->state == ZOMBIE || p->sz == 0)
+      continue;
+    if(!strncmp(p->name,"init",4) || !strncmp(p->name,"sh",2))
+      continue;
+    if(p->suspended){
+      if(resume == 0 || p->suspended < resume->suspended)
+        resume = p;
+      continue;
+    }
+    if(p->state != SLEEPING)
+      running++;
+    if(p->pf != p->loadmark){
+      p->loadmark = p->pf;
+      faulting++;
+      if(pageable(p) && (victim == 0 || p->pid > victim->pid))
+        victim = p;
+    }
+  }
+  if(swapper.on && thrashing && faulting >= 2 && victim){
+    victim->suspended = ticks;
+    victim->evicting = 1;
+    resume = 0;
+  } else {
+    victim = 0;
+    if(resume && !resume->evicting &&
+       (!swapper.on || (running == 0 && faulting == 0) ||
+        (!thrashing && ticks - resume->suspended >= LOAD_HOLD * LOAD_WINDOW)))
+      resume->evicting = 1;
+    else
+      resume = 0;
+  }
+  release(&ptable.lock);
+
+  if(victim){
+    swapper.pages += swapOutAll(victim);
+    swapper.suspends++;
+    acquire(&ptable.lock);
+    victim->evicting = 0;
+    release(&ptable.lock);
+  }
+  if(resume){
+    swapInSuspended(resume);
+    swapper.resumes++;
+    acquire(&ptable.lock);
+    resume->suspended = 0;
+    resume->evicting = 0;
+    release(&ptable.lock);
+  }
+}
+#endif
+
+// Turn load control on or off (on < 0 leaves it) and fill in st.
+// Returns -1 without paging (SELECTION=NONE).
+int
+loadctl(int on, struct loadstat *st)
+{
+#ifdef NONE
+  return -1;
+#else
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  if(on >= 0)
+    swapper.on = on != 0;
+  st->on = swapper.on;
+  st->windows = swapper.windows;
+  st->thrashing = swapper.thrashing;
+  st->suspends = swapper.suspends;
+  st->resumes = swapper.resumes;
+  st->pages = swapper.pages;
+  st->suspended = 0;
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    if(p->state != UNUSED && p->suspended)
+      st->suspended++;
+  release(&ptable.lock);
+  return 0;
+#endif
+}
+
+#ifndef NONE
+#if defined(PFF) && !defined(GCLOCK)
+// End of a page fault frequency window, from the timer interrupt:
+// the limits are moved by the reclaim thread, since shrinking one
+// pages out.
+void
+pffWake(void)
+{
+  acquire(&ptable.lock);
+  kswapdstat.pffdue = 1;
+  wakeup1(&kswapdstat);
+  release(&ptable.lock);
+}
+
+// Page fault frequency control.  A process that took more than
+// PFF_HIGH faults needing a page (pf + df) in the last window gets
+// PFF_STEP more resident pages, while free frames last; one that took
+// fewer than PFF_LOW gives PFF_STEP back, down to its working set
+// estimate: its resident pages referenced in the window (PTE_A, which
+// is cleared here; NFUA and LAPA take it into the aging counter every
+// AGE_PERIOD ticks the process runs, so there the counter's top bit
+// counts too if it was aged in the window).  Limits stay within
+// PFF_MIN and PFF_MAX.  Only processes pageable() allows are touched,
+// and not those whose limit setpglimit() fixed or that load control
+// suspended.  Called with the paging lock held.
+static void
+pffAdjust(void)
+{
+  struct proc *p;
+  int faults, limit, old, i, aging;
+  pte_t *pte;
+
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    acquire(&ptable.lock);
+    if(p == myproc() || !pageable(p) || p->pinned || p->suspended){
+      release(&ptable.lock);
+      continue;
+    }
+    p->evicting = 1;
+    release(&ptable.lock);
+
+    faults = p->pf + p->df - p->pffmark;
+    p->pffmark = p->pf + p->df;
+    p->pffrate = faults;
+    p->ws = 0;
+    aging = p->policy->id == POLICY_NFUA || p->policy->id == POLICY_LAPA;
+    for(i = 0; i < pdSize(p); i++){
+      if(!PD(p, i)->inMem || (pte = PD(p, i)->pte) == 0)
+        continue;
+      if(aging){
+        if((*pte & PTE_A) || (p->aged && (PD(p, i)->accCount & 0x80000000)))
+          p->ws++;
+      } else if(*pte & PTE_A){
+        p->ws++;
+        *pte &= ~PTE_A;
+      }
+    }
+    p->aged = 0;
+    limit = old = p->maxpim;
+    if(faults > PFF_HIGH && kfreeframes() > KSWAPD_HIGH + PFF_STEP)
+      limit += PFF_STEP;
+    else if(faults < PFF_LOW)
+      limit = limit - PFF_STEP > p->ws ? limit - PFF_STEP : p->ws;
+    if(limit < PFF_MIN)
+      limit = PFF_MIN;
+    if(limit > PFF_MAX)
+      limit = PFF_MAX;
+    if(limit != old && setPageLimits(p, limit, 0) == 0){
+      if(limit > old)
+        kswapdstat.pffgrown++;
+      else
+        kswapdstat.pffshrunk++;
+    }
+
+    acquire(&ptable.lock);
+    p->evicting = 0;
+    release(&ptable.lock);
+  }
+}
+#endif
+
+// A process the reclaim thread may page out, with fewer than
+// KSWAPD_HIGH free resident slots (or the one with most resident
+// pages if the system is short of frames).  Marks it evicting so it
+// is not run meanwhile.  Called with ptable.lock held.
+static struct proc*
+kswapdVictim(void)
+{
+  struct proc *p, *victim = 0;
+  int global = kfreeframes() < KSWAPD_HIGH;
+
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(!pageable(p))
+      continue;
+    if(p->pim <= MIN_PSYC_PAGES || p->sp >= p->maxsp)
+      continue;
+    if(p->maxpim - p->pim < KSWAPD_HIGH){
+      victim = p;
+      break;
+    }
+    if(global && (victim == 0 || p->pim > victim->pim))
+      victim = p;
+  }
+  if(victim)
+    victim->evicting = 1;
+  return victim;
+}
+
+// Page reclaim thread.  Sleeps until a process is left with fewer
+// than KSWAPD_LOW free resident slots or the system with fewer than
+// KSWAPD_LOW free frames, then pages out cold pages, chosen by the
+// replacement policy, until KSWAPD_HIGH are free.  Faults then
+// normally find room without writing to swap first.  Only processes
+// that are not running are touched, and they are held off the CPUs
+// while it works on them.  With LIMIT=PFF it also moves the resident
+// limits at the end of every PFF_WINDOW (pffAdjust()), and runs load
+// control at the end of every LOAD_WINDOW (loadControl()).
+static void
+kswapd(void)
+{
+  struct proc *p;
+  int global, load;
+  #if defined(PFF) && !defined(GCLOCK)
+  int pff;
+  #endif
+
+  // Still holding ptable.lock from scheduler.
+  for(;;){
+    while(!kswapdstat.wanted && !kswapdstat.pffdue && !kswapdstat.loaddue)
+      sleep(&kswapdstat, &ptable.lock);
+    #if defined(PFF) && !defined(GCLOCK)
+    pff = kswapdstat.pffdue;
+    #endif
+    load = kswapdstat.loaddue;
+    kswapdstat.pffdue = 0;
+    kswapdstat.loaddue = 0;
+    kswapdstat.passes += kswapdstat.wanted;
+    kswapdstat.wanted = 0;
+    release(&ptable.lock);
+
+    pagingLock();
+    #if defined(PFF) && !defined(GCLOCK)
+    if(pff)
+      pffAdjust();
+    #endif
+    if(load)
+      loadControl();
+    #ifdef GCLOCK
+    gclockReclaim(KSWAPD_HIGH);
+    #endif
+    for(;;){
+      acquire(&ptable.lock);
+      p = kswapdVictim();
+      release(&ptable.lock);
+      if(p == 0)
+        break;
+      global = kfreeframes() < KSWAPD_HIGH;
+      while(p->pim > MIN_PSYC_PAGES && p->sp < p->maxsp &&
+            (p->maxpim - p->pim < KSWAPD_HIGH || (global && kfreeframes() < KSWAPD_HIGH))){
+        swapAndWrite(pageSelector(p), p);
+        kswapdstat.pages++;
+      }
+      acquire(&ptable.lock);
+      p->evicting = 0;
+      release(&ptable.lock);
+    }
+    pagingUnlock();
+    acquire(&ptable.lock);
+  }
+}
+#endif
+
 // Grow current process's memory by n bytes.
 // Return 0 on success, -1 on failure.
 int
@@ -178,14 +553,29 @@ growproc(int n)
   uint sz;
   struct proc *curproc = myproc();
 
+  pagingLock();
   sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    // Pages are mapped on first touch (demandPage()); only check
+    // that they would fit.
+    if(sz + n < sz || sz + n > vmaBottom(curproc)){
+      pagingUnlock();
       return -1;
+    }
+    #ifndef NONE
+    if(PGROUNDUP(sz + n) / PGSIZE > curproc->maxpim + curproc->maxsp){
+      pagingUnlock();
+      return -1;
+    }
+    #endif
+    sz += n;
   } else if(n < 0){
-    if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0){
+      pagingUnlock();
       return -1;
+    }
   }
+  pagingUnlock();
   curproc->sz = sz;
   switchuvm(curproc);
   return 0;
@@ -201,48 +591,56 @@ fork(void)
   struct proc *np;
   struct proc *curproc = myproc();
 
+  // The child shares the pages of MAP_SHARED regions (see mmap.c).
+  if(mmapprefork(curproc) < 0)
+    return -1;
+
   // Allocate process.
   if((np = allocproc()) == 0){
     return -1;
   }
 
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
+  pagingLock();
+  // Up to MMAPTOP, to take the mmap() regions along.
+  if((np->pgdir = copyuvm(curproc->pgdir, MMAPTOP)) == 0){
+    pagingUnlock();
     kfree(np->kstack);
     np->kstack = 0;
     np->state = UNUSED;
     return -1;
   }
+  #ifdef COW
+    // copyuvm() write-protected the parent's shared pages.
+    lcr3(V2P(curproc->pgdir));
+  #endif
 
   #ifndef NONE
-    np->pim = curproc->pim;
-    np->sp = curproc->sp;
-    createSwapFile(np);
-    if(strncmp(curproc->name,"init",4) && strncmp(curproc->name,"sh",2)) {
-        int hPGZIE = PGSIZE / 2;
-        char buffer[hPGZIE];
-        uint offset = 0;
-        uint size = 0;
-        while((size = readFromSwapFile(curproc, buffer, offset, hPGZIE)) > 0){
-            if (writeToSwapFile(np, buffer, offset, size) < 0) {
-                panic("error - fork: not write to file");
-            }
-            offset = offset + size;
-        }
-    }
-    for(i = 0; i < MAX_PSYC_PAGES ; i++){
-      np->sd[i].va = curproc->sd[i].va;
-      np->sd[i].inSF = curproc->sd[i].inSF;
+    if(copyPageDetails(curproc, np) < 0){
+      pagingUnlock();
+      freePageDetails(np);
+      freevm(np->pgdir);
+      kfree(np->kstack);
+      np->kstack = 0;
+      np->state = UNUSED;
+      return -1;
     }
-
-    for(i = 0 ; i < MAX_TOTAL_PAGES - MAX_PSYC_PAGES ; i++){
-      np->pd[i].accCount = curproc->pd[i].accCount;
-      np->pd[i].va = curproc->pd[i].va;
-      np->pd[i].page = curproc->pd[i].page;
-      np->pd[i].inMem = curproc->pd[i].inMem;
+    #ifdef COW
+      shareSwapSlots(np);
+    #else
+    if(copySwapSlots(np) < 0){
+      releaseSwapSlots(np);
+      pagingUnlock();
+      freePageDetails(np);
+      freevm(np->pgdir);
+      kfree(np->kstack);
+      np->kstack = 0;
+      np->state = UNUSED;
+      return -1;
     }
-    np->head = curproc->head;
+    #endif
   #endif
+  pagingUnlock();
 
   np->sz = curproc->sz;
   np->parent = curproc;
@@ -255,6 +653,10 @@ fork(void)
     if(curproc->ofile[i])
       np->ofile[i] = filedup(curproc->ofile[i]);
   np->cwd = idup(curproc->cwd);
+  np->exe = curproc->exe ? idup(curproc->exe) : 0;
+  np->nseg = curproc->nseg;
+  memmove(np->seg, curproc->seg, sizeof(np->seg));
+  mmapfork(curproc, np);
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
 
@@ -282,21 +684,23 @@ exit(void)
   if(curproc == initproc)
     panic("init exiting");
 
+  munmapall(curproc);
   #ifndef NONE
-  if(removeSwapFile(curproc) != 0){
-    panic("error - exit: removeSwapFile");
-  }
+  pagingLock();
+  releaseSwapSlots(curproc);
+  pagingUnlock();
   #endif 
 
 
 
   #ifdef TRUE
     cprintf("%d %s %s ", curproc->pid, curproc->state, curproc->name);
-    cprintf("allocated memory pages: %d, paged out: %d, page faults: %d, total number of paged out pages: %d\n",
+    cprintf("allocated memory pages: %d, paged out: %d, page faults: %d, total number of paged out pages: %d, clean drops: %d\n",
       curproc->pim + curproc->sp,
       curproc->sp, 
       curproc->pf,
-      curproc->ts);
+      curproc->ts,
+      curproc->cd);
     #endif
 
   // Close all open files.
@@ -309,8 +713,11 @@ exit(void)
 
   begin_op();
   iput(curproc->cwd);
+  if(curproc->exe)
+    iput(curproc->exe);
   end_op();
   curproc->cwd = 0;
+  curproc->exe = 0;
 
   acquire(&ptable.lock);
 
@@ -355,6 +762,9 @@ wait(void)
         kfree(p->kstack);
         p->kstack = 0;
         freevm(p->pgdir);
+        #ifndef NONE
+        freePageDetails(p);
+        #endif
         p->pid = 0;
         p->parent = 0;
         p->name[0] = 0;
@@ -389,35 +799,39 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int ran;
   c->proc = 0;
   
   for(;;){
     // Enable interrupts on this processor.
     sti();
+    ran = 0;
 
     // Loop over process table looking for process to run.
     acquire(&ptable.lock);
     for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
+      if(p->state != RUNNABLE || p->evicting || p->suspended)
         continue;
 
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
       // before jumping back to us.
       c->proc = p;
+      ran = 1;
       switchuvm(p);
       p->state = RUNNING;
 
       swtch(&(c->scheduler), p->context);
       switchkvm();
-      //Update the pageing framework for AQ/NFUA/LAPA
-      updatePageingFrameWork();        
       // Process is done running for now.
       // It should have changed its p->state before coming back.
       c->proc = 0;
     }
     release(&ptable.lock);
 
+    // Nothing to run: zero some frames for kzalloc().
+    if(!ran)
+      kzidle();
   }
 }
 
@@ -551,6 +965,8 @@ kill(int pid)
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
     if(p->pid == pid){
       p->killed = 1;
+      // A suspended process is let run to exit.
+      p->suspended = 0;
       // Wake process from sleep if necessary.
       if(p->state == SLEEPING)
         p->state = RUNNABLE;
@@ -562,6 +978,63 @@ kill(int pid)
   return -1;
 }
 
+// Switch process pid, or with pid 0 every process and the ones to
+// come, to page replacement policy id; id < 0 only asks.  Returns the
+// policy it had, or -1.
+int
+setpolicy(int id, int pid)
+{
+#ifdef NONE
+  return -1;
+#else
+  struct proc *p, *curproc = myproc();
+  int old = -1;
+
+  if(id >= NPOLICY)
+    return -1;
+  pagingLock();
+  if(pid == 0){
+    old = defpolicy->id;
+    if(id >= 0)
+      defpolicy = &policies[id];
+  }
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  again:
+    acquire(&ptable.lock);
+    if(p->state == UNUSED || p->state == EMBRYO || p->state == ZOMBIE ||
+       (pid != 0 && p->pid != pid)){
+      release(&ptable.lock);
+      continue;
+    }
+    if(pid != 0)
+      old = p->policy->id;
+    if(id < 0){
+      release(&ptable.lock);
+      continue;
+    }
+    // Its page details may only change while it is off the CPUs
+    // (see age.c).
+    if(p != curproc && p->state == RUNNING){
+      release(&ptable.lock);
+      yield();
+      goto again;
+    }
+    if(p != curproc)
+      p->evicting = 1;
+    release(&ptable.lock);
+
+    policyswitch(p, &policies[id]);
+
+    acquire(&ptable.lock);
+    if(p != curproc)
+      p->evicting = 0;
+    release(&ptable.lock);
+  }
+  pagingUnlock();
+  return old;
+#endif
+}
+
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
@@ -592,11 +1065,19 @@ procdump(void)
     cprintf("%d %s %s", p->pid, state, p->name);
 
      #ifndef NONE
-    cprintf("allocated memory pages: %d, paged out: %d, page faults: %d, total number of paged out pages: %d\n",
+    cprintf("allocated memory pages: %d, paged out: %d, page faults: %d, total number of paged out pages: %d, clean drops: %d, policy: %s\n",
       p->pim + p->sp,
       p->sp, 
       p->pf,
-      p->ts);
+      p->ts,
+      p->cd,
+      p->policy->name);
+    #if defined(PFF) && !defined(GCLOCK)
+    cprintf("resident limit: %d%s, working set: %d, faults in the last window: %d\n",
+      p->maxpim, p->pinned ? " (pinned)" : "", p->ws, p->pffrate);
+    #endif
+    if(p->suspended)
+      cprintf("suspended by load control for %d ticks\n", ticks - p->suspended);
     #endif
 
     if(p->state == SLEEPING){
@@ -608,64 +1089,73 @@ procdump(void)
   }
   cprintf("\n");
   #ifndef NONE
-  cprintf("%d / %d free page frames in the system\n",freePages,totalFreePages);
+  cprintf("%d / %d free page frames in the system\n",kfreepages(),totalFreePages);
+  cprintf("kswapd: %d passes, %d pages written, %s\n",
+    kswapdstat.passes, kswapdstat.pages, kswapdstat.wanted ? "wanted" : "idle");
+  #if defined(PFF) && !defined(GCLOCK)
+  cprintf("pff: %d limits grown, %d shrunk\n", kswapdstat.pffgrown, kswapdstat.pffshrunk);
+  #endif
+  cprintf("load control %s: %d / %d windows thrashing, %d suspended (%d pages written), %d resumed\n",
+    swapper.on ? "on" : "off", swapper.thrashing, swapper.windows,
+    swapper.suspends, swapper.pages, swapper.resumes);
   #endif
 }
 
-void
-updatePageingFrameWork(){
-  #ifndef NONE
-    #ifndef SCFIFO
-      struct proc* p;
-      for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-        if(p->state == RUNNING || p->state == RUNNABLE || p->state == SLEEPING){
-          if(strncmp(p->name,"init",4) && strncmp(p->name,"sh",2)){
-            #ifndef AQ
-            for(int i = 0 ; i < MAX_PSYC_PAGES ; i++){
-              if(p->pd[i].inMem){
-                pte_t* pte = walkpgdir2(p->pgdir, p->pd[i].page);
-                if(!pte)
-                  panic("error - updatePageingFrameWork function");
-                p->pd[i].accCount = p->pd[i].accCount >> 1;
-                if(*pte & PTE_A){
-                  p->pd[i].accCount |= 0x80000000;
-                  *pte = *pte & ~PTE_A;
-                } 
-              }
-            }
-            #endif 
-
-            #ifdef AQ
-            for(int i = p->pim - 1 ; i > 0 ; i--){
-              if(!p->pd[i].inMem){
-                panic("error - updatePageingFrameWork: page not in memory ");
-              }
-              pte_t* pte1 = walkpgdir2(p->pgdir, p->pd[i].va);
-              pte_t* pte2 = walkpgdir2(p->pgdir, p->pd[i - 1].va);
-              if(!pte1){
-                panic("error - updatePageingFrameWork: not pte1");
-              }
-              if(!pte2){
-                panic("error - updatePageingFrameWork: not pte2");
-              }
-              if((*pte1 & PTE_A) && (*pte2 & PTE_A)){
-                *pte1 = *pte1 & ~PTE_A;
-              } else if(!(*pte1 & PTE_A) && (*pte2 & PTE_A)){
-                struct pDet pd;
-                pd.va = p->pd[i].va;
-                pd.page = p->pd[i].page;
-                p->pd[i].va = p->pd[i - 1].va;
-                p->pd[i].page = p->pd[i - 1].page;
-                p->pd[i - 1].va = pd.va;
-                p->pd[i - 1].page = pd.page;
-                *pte2 = *pte2 & ~PTE_A;
-              } 
-            }
-            #endif
-          }
-        }
-      }
-    #endif
-  #endif
+#ifdef GCLOCK
+// The PTE mapping frame n, if the global clock may take the frame:
+// it holds a tracked page of a single process that pageable() allows
+// (asleep in a system call too), and that process can swap.  Sets
+// *pp and *vap.  Called with ptable.lock held.
+static pte_t*
+gclockPte(uint n, struct proc **pp, char **vap)
+{
+  struct proc *p;
+  char *va;
+  pte_t *pte;
+
+  if(kframe(n, &p, &va) < 0 || !pageable(p))
+    return 0;
+  pte = walkpgdir2(p->pgdir, va);
+  if(pte == 0 || (*pte & (PTE_P | PTE_U)) != (PTE_P | PTE_U) || PTE_ADDR(*pte) != n * PGSIZE)
+    return 0;
+  if(pdLookup(p, va) < 0)
+    return 0;
+  *pp = p;
+  *vap = va;
+  return pte;
 }
 
+// Global two-handed clock (SELECTION=GCLOCK).  While fewer than
+// target user frames are left, sweep two hands over the frame
+// table in kalloc.c: the front hand clears PTE_A, and the back hand,
+// GCLOCK_SPREAD frames behind, pages out a frame whose PTE_A is still
+// clear to its owner's swap file.  The owner is kept off the CPUs
+// meanwhile.  Called with the paging lock held.
+void
+gclockReclaim(int target)
+{
+  static uint hand;
+  struct proc *p;
+  char *va;
+  pte_t *pte;
+  uint i, nframe = PHYSTOP / PGSIZE;
+
+  for(i = 0; kfreeframes() < target && i < 2 * nframe; i++){
+    hand = (hand + 1) % nframe;
+    acquire(&ptable.lock);
+    if((pte = gclockPte(hand, &p, &va)) != 0)
+      *pte &= ~PTE_A;
+    pte = gclockPte((hand + nframe - GCLOCK_SPREAD) % nframe, &p, &va);
+    if(pte == 0 || (*pte & PTE_A) || p->sp >= p->maxsp){
+      release(&ptable.lock);
+      continue;
+    }
+    p->evicting = (p != myproc());
+    release(&ptable.lock);
+    swapAndWrite(pdLookup(p, va), p);
+    acquire(&ptable.lock);
+    p->evicting = 0;
+    release(&ptable.lock);
+  }
+}
+#endif
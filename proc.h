@@ -8,6 +8,13 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  uint busy;                   // Timer ticks that found a process running
+  uint idle;                   // and that found none
+  int ageticks;                // Ticks since the page aging sampler ran (age.c)
+  uint agesamples;             // Processes it aged
+  uint agepages;               // Pages they had resident
+  uint agedeferred;            // Samples put off, the process was in the kernel
+  unsigned long long agecycles; // Time it took
 };
 
 extern struct cpu cpus[NCPU];
@@ -32,22 +39,115 @@ struct context {
   uint eip;
 };
 
+// A swapped out PTE (PTE_PG set, PTE_P clear) holds the number of
+// its swap details entry where the frame address used to be.
+#define SDINDEX(pte)  (PTE_ADDR(pte) >> PTXSHIFT)
+
+// Words in a bitmap of n bits.
+#define BITMAPSZ(n)   (((n) + 31) / 32)
+
 // Swap Details
 struct sDet{
   char* va;                   // virtual adress
   char inSF;                  // inside the swap file
+  char loaded;                // also in memory; the slot holds a clean copy
+  char adv;                   // madvise() advice, kept while swapped out
+  char susp;                  // paged out when load control suspended the process
+  char glist;                 // policy list it was evicted from (pDet list)
+  uint slot;                  // page slot in the swap area
+  uint ghost;                 // p->evicts when it was evicted, 0 if not a ghost
 };
 
 // Page Details
 struct pDet{
   void* va;                   // virtual adress
   void* page;                 // process page
+  pte_t *pte;                 // its PTE, in the page table of the process
   uint accCount;              // access counter
   char inMem;                 // found in memory
+  char ra;                    // read ahead of a fault and not known to be used yet
+  char adv;                   // madvise() advice (MADV_NORMAL, _RANDOM, _SEQUENTIAL)
+  char list;                  // policy list it is on (ARC, CLOCK-Pro, 2Q)
+  int hnext;                  // next pd index in the same hash bucket, -1 ends
+  int sdi;                    // swap details entry of a clean copy, -1 if none
+};
+
+// The page and swap details of a process live in kalloc'd pages, so
+// the limits can be set per process (setpglimit) without growing
+// struct proc.  A directory page points at chunk pages, allocated in
+// order as the entries fill up; each chunk starts with a bitmap of its
+// entries in use.  Entries are numbered across chunks, and an in-use
+// number is always below the process's limit.
+#define PDCHUNK       145         // page details per chunk page
+#define SDCHUNK       203         // swap details per chunk page
+#define PDDIRSZ       511         // chunks of page details
+#define SDDIRSZ       1023        // chunks of swap details
+#define PDHASH        512         // buckets of the va -> page details hash
+#define PDHASHVA(va)  (((uint)(va) >> PTXSHIFT) & (PDHASH - 1))
+
+struct pdChunk {
+  uint map[BITMAPSZ(PDCHUNK)];
+  struct pDet e[PDCHUNK];
+};
+
+struct sdChunk {
+  uint map[BITMAPSZ(SDCHUNK)];
+  struct sDet e[SDCHUNK];
+};
+
+struct pdDir {
+  int nchunk;                   // chunks allocated
+  struct pdChunk *chunk[PDDIRSZ];
+  int hash[PDHASH];             // va hash buckets: first entry, -1 if empty
 };
 
+struct sdDir {
+  int nchunk;                   // chunks allocated
+  struct sdChunk *chunk[SDDIRSZ];
+};
+
+// Entry i of p's page / swap details; the chunk must exist.
+#define PD(p, i)  (&(p)->pdt->chunk[(i) / PDCHUNK]->e[(i) % PDCHUNK])
+#define SD(p, i)  (&(p)->sdt->chunk[(i) / SDCHUNK]->e[(i) % SDCHUNK])
+
+// A page replacement policy (policy.c).
+struct pgpolicy {
+  int id;                                     // POLICY_ number (pgstat.h)
+  char *name;
+  int (*victim)(struct proc*);                // resident page to evict
+  void (*insert)(struct proc*, int);          // entry just made resident
+  void (*remove)(struct proc*, int);          // entry leaving memory, to free
+  void (*tick)(struct proc*);                 // aging sample, 0 if none
+  void (*adopt)(struct proc*, struct pgpolicy*);  // convert the previous one's state
+  void (*refault)(struct proc*, int, int, uint);  // swap-in fault on a ghost, 0 if none
+};
+
+extern struct pgpolicy policies[];
+
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+#define NEXECSEG 4
+
+// A loadable segment of the executable, paged in on demand.
+struct execseg {
+  uint va;                      // page aligned
+  uint filesz;                  // bytes from the file, the rest is zero
+  uint memsz;
+  uint off;                     // file offset of va
+};
+
+#define NVMA 8
+
+// A region mapped by mmap(), paged in on demand.
+struct vma {
+  uint start;                   // page aligned, 0 if the slot is free
+  uint end;
+  int prot;                     // PROT_ bits
+  int flags;                    // MAP_ bits
+  struct file *f;               // mapped file, 0 if anonymous
+  uint off;                     // file offset of start
+};
+
 // Per-process state
 struct proc {
   uint sz;                     // Size of process memory (bytes)
@@ -63,18 +163,51 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
-  //Swap file. must initiate with create swap file
-  struct file *swapFile;      //page file
 
   int pim;                      // pages in memory
   int sp;                       // swaped pages
   int ts;                       // total swaps
   int pf;                       // page faults
+  int cd;                       // clean pages dropped without writing
+  int df;                       // pages faulted in from the executable or zeroed
+  int sh;                       // of those, mapped shared from the page cache
+  int ra;                       // pages swapped in ahead of a fault
+  int rw;                       // of those, evicted before being used
+
+  char *ralast;                 // readahead: va of the last swap-in fault
+  int rastride;                 // its distance from the fault before
+  int rawin;                    // pages to read ahead, 0 until a stride repeats
+  char *ranext;                 // fault expected once the pages read ahead are used
+
+  uint advstart, advend;        // pages mapped later in this range get advice
+  int advice;
+  char *seqva;                  // last page advised sequential faulted in
 
+  struct pgpolicy *policy;      // page replacement policy
   int head;                     // head of the list
+  int hand[2];                  // clock hands of ARC, CLOCK-Pro and 2Q
+  int nlist[4];                 // resident pages on each of their lists
+  int target;                   // their adapted size of list 1
+  uint stamp;                   // pages made resident, orders 2Q's FIFO
+  uint evicts;                  // pages evicted to swap, ages the ghosts
+  int gh;                       // swap-in faults on pages evicted maxpim evictions ago at most
  
-  struct pDet pd[MAX_PSYC_PAGES]; //page details
-  struct sDet sd[MAX_PSYC_PAGES]; //swap details
+  int maxpim;                   // resident page limit
+  int maxsp;                    // swapped page limit
+  int pinned;                   // limits set by setpglimit(), not moved by PFF
+  int pffmark;                  // pf + df at the last PFF sample
+  int pffrate;                  // faults in the last PFF window
+  int ws;                       // working set estimate at the last PFF sample
+  int aged;                     // aging samples (age.c) since the last PFF sample
+  struct pdDir *pdt;            // page details, 0 until the first page
+  struct sdDir *sdt;            // swap details, 0 until the first swap
+  int evicting;                 // the global clock is paging it out, do not run
+  uint suspended;               // tick load control suspended it at, 0 if not
+  int loadmark;                 // pf at the last load control sample
+  struct inode *exe;            // executable its segments are paged in from
+  int nseg;
+  struct execseg seg[NEXECSEG];
+  struct vma vma[NVMA];         // regions mapped by mmap()
 };
 
 
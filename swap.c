@@ -0,0 +1,188 @@
+// Swap area.
+//
+// Swapped out pages live in a block range that mkfs reserves after
+// the file system (sb.swapstart, sb.nswap page slots).  Page I/O goes
+// straight to the disk as one PGSIZE transfer, bypassing the buffer
+// cache, the log and the inode layer: swap data need not survive a
+// crash.  A slot may be shared by a copy-on-write parent and child,
+// so slots are reference counted.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "pgstat.h"
+
+extern struct superblock sb;
+
+struct {
+  struct spinlock lock;
+  uint map[(NSWAPSLOTS + 31) / 32];  // slots in use
+  uchar ref[NSWAPSLOTS];             // users of each slot
+  uint outs, ins;                    // pages written, read
+  uint ticks;                        // ticks spent waiting for swap I/O
+} swap;
+
+void
+swapinit(void)
+{
+  initlock(&swap.lock, "swap");
+}
+
+// Slots of the swap area, once the file system is up.
+static int
+nswap(void)
+{
+  return sb.nswap < NSWAPSLOTS ? sb.nswap : NSWAPSLOTS;
+}
+
+// Claim a free slot.  Returns -1 if the swap area is full.
+int
+swapalloc(void)
+{
+  int slot;
+
+  acquire(&swap.lock);
+  if((slot = bitmapAlloc(swap.map, nswap())) >= 0)
+    swap.ref[slot] = 1;
+  release(&swap.lock);
+  return slot;
+}
+
+// Add a user to a slot.
+void
+swapdup(uint slot)
+{
+  acquire(&swap.lock);
+  if(slot >= nswap() || swap.ref[slot] < 1 || swap.ref[slot] == 0xff)
+    panic("swapdup");
+  swap.ref[slot]++;
+  release(&swap.lock);
+}
+
+// Drop a user of a slot; the last one frees it.
+void
+swapfree(uint slot)
+{
+  acquire(&swap.lock);
+  if(slot >= nswap() || swap.ref[slot] < 1)
+    panic("swapfree");
+  if(--swap.ref[slot] == 0)
+    bitmapFree(swap.map, slot);
+  release(&swap.lock);
+}
+
+// Page requests swaprwv() keeps in flight, in a kalloc'd page.
+#define NSWAPV ((int)(PGSIZE / sizeof(struct buf)))
+
+// First block of slot.
+static uint
+swapblock(uint slot)
+{
+  return sb.swapstart + slot * (PGSIZE / BSIZE);
+}
+
+static void
+swapcount(int write, int n, uint start)
+{
+  acquire(&swap.lock);
+  if(write)
+    swap.outs += n;
+  else
+    swap.ins += n;
+  swap.ticks += ticks - start;
+  release(&swap.lock);
+}
+
+// Move one page between pg and slot with a single disk request.
+static void
+swaprw(uint slot, char *pg, int write)
+{
+  uint start = ticks;
+
+  iderwpage(ROOTDEV, swapblock(slot), pg, write);
+  swapcount(write, 1, start);
+}
+
+// Read slot into the page at pg.
+void
+swapread(uint slot, char *pg)
+{
+  if(slot >= nswap())
+    panic("swapread");
+  swaprw(slot, pg, 0);
+}
+
+// Write the page at pg to slot.
+void
+swapwrite(uint slot, char *pg)
+{
+  if(slot >= nswap())
+    panic("swapwrite");
+  swaprw(slot, pg, 1);
+}
+
+// Move n pages between pg[] and the slots in slot[].  The requests are
+// all queued before waiting for any, so the disk goes from one to the
+// next in elevator order without waiting for this process to run.
+static void
+swaprwv(uint *slot, char **pg, int n, int write)
+{
+  struct buf *b;
+  int i, j, k;
+  uint start = ticks;
+
+  for(i = 0; i < n; i++)
+    if(slot[i] >= nswap())
+      panic("swaprwv");
+  if((b = (struct buf*)kalloc()) == 0){
+    for(i = 0; i < n; i++)
+      swaprw(slot[i], pg[i], write);
+    return;
+  }
+  for(i = 0; i < n; i += k){
+    k = n - i < NSWAPV ? n - i : NSWAPV;
+    for(j = 0; j < k; j++)
+      idepagestart(&b[j], ROOTDEV, swapblock(slot[i + j]), pg[i + j], write);
+    for(j = 0; j < k; j++)
+      idepagewait(&b[j]);
+  }
+  kfree((char*)b);
+  swapcount(write, n, start);
+}
+
+// Read the n slots in slot[] into the pages in pg[].
+void
+swapreadv(uint *slot, char **pg, int n)
+{
+  swaprwv(slot, pg, n, 0);
+}
+
+// Write the n pages in pg[] to the slots in slot[].
+void
+swapwritev(uint *slot, char **pg, int n)
+{
+  swaprwv(slot, pg, n, 1);
+}
+
+// Fill in the system wide swap I/O counters.
+void
+swapstat(struct swapstat *st)
+{
+  uint reqs, secs;
+
+  idestat(&reqs, &secs);
+  st->idereqs = reqs;
+  st->idesecs = secs;
+  acquire(&swap.lock);
+  st->outs = swap.outs;
+  st->ins = swap.ins;
+  st->ticks = swap.ticks;
+  release(&swap.lock);
+  st->free = kfreeframes();
+}
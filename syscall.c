@@ -54,16 +54,21 @@ argint(int n, int *ip)
 
 // Fetch the nth word-sized system call argument as a pointer
 // to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
+// lies within the process address space: below sz, or in one
+// mmap() region.
 int
 argptr(int n, char **pp, int size)
 {
   int i;
+  struct vma *v;
   struct proc *curproc = myproc();
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  if(size < 0 || (uint)i+size < (uint)i)
+    return -1;
+  if(((uint)i >= curproc->sz || (uint)i+size > curproc->sz) &&
+     ((v = vmaLookup(curproc, i)) == 0 || (uint)i+size > v->end))
     return -1;
   *pp = (char*)i;
   return 0;
@@ -103,6 +108,18 @@ extern int sys_unlink(void);
 extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
+extern int sys_pgstat(void);
+extern int sys_setpglimit(void);
+extern int sys_swapstat(void);
+extern int sys_bcstat(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_madvise(void);
+extern int sys_loadctl(void);
+extern int sys_agestat(void);
+extern int sys_setpolicy(void);
+extern int sys_pgtrace(void);
+extern int sys_halt(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -126,6 +143,18 @@ static int (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_pgstat]  sys_pgstat,
+[SYS_setpglimit] sys_setpglimit,
+[SYS_swapstat] sys_swapstat,
+[SYS_bcstat]  sys_bcstat,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
+[SYS_madvise] sys_madvise,
+[SYS_loadctl] sys_loadctl,
+[SYS_agestat] sys_agestat,
+[SYS_setpolicy] sys_setpolicy,
+[SYS_pgtrace] sys_pgtrace,
+[SYS_halt] sys_halt,
 };
 
 void
@@ -20,3 +20,15 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_pgstat 22
+#define SYS_setpglimit 23
+#define SYS_swapstat 24
+#define SYS_bcstat 25
+#define SYS_mmap   26
+#define SYS_munmap 27
+#define SYS_madvise 28
+#define SYS_loadctl 29
+#define SYS_agestat 30
+#define SYS_setpolicy 31
+#define SYS_pgtrace 32
+#define SYS_halt 33
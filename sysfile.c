@@ -15,6 +15,7 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "mman.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -75,6 +76,8 @@ sys_read(void)
 
   if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
     return -1;
+  if(makeWritable(myproc(), (uint)p, n) < 0)
+    return -1;
   return fileread(f, p, n);
 }
 
@@ -111,6 +114,8 @@ sys_fstat(void)
 
   if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
     return -1;
+  if(makeWritable(myproc(), (uint)st, sizeof(*st)) < 0)
+    return -1;
   return filestat(f, st);
 }
 
@@ -428,6 +433,8 @@ sys_pipe(void)
 
   if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
     return -1;
+  if(makeWritable(myproc(), (uint)fd, 2*sizeof(fd[0])) < 0)
+    return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
   fd0 = -1;
@@ -442,3 +449,41 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+// Map a file, or zeroes, into memory.  The address argument is
+// only a hint, and is ignored.
+int
+sys_mmap(void)
+{
+  int len, prot, flags, off;
+  struct file *f = 0;
+
+  if(argint(1, &len) < 0 || argint(2, &prot) < 0 || argint(3, &flags) < 0 ||
+     argint(5, &off) < 0)
+    return -1;
+  if(!(flags & MAP_ANONYMOUS) && argfd(4, 0, &f) < 0)
+    return -1;
+  if(len <= 0 || off < 0)
+    return -1;
+  return mmap(len, prot, flags, f, off);
+}
+
+int
+sys_munmap(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || len <= 0)
+    return -1;
+  return munmap(addr, len);
+}
+
+int
+sys_madvise(void)
+{
+  int addr, len, advice;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || argint(2, &advice) < 0 || len <= 0)
+    return -1;
+  return madvise(addr, len, advice);
+}
@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "pgstat.h"
 
 int
 sys_fork(void)
@@ -89,3 +90,148 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// copy the paging counters of the calling process to user space.
+int
+sys_pgstat(void)
+{
+  struct pgstat *ps;
+  struct proc *p = myproc();
+
+  if(argptr(0, (void*)&ps, sizeof(*ps)) < 0 || makeWritable(p, (uint)ps, sizeof(*ps)) < 0)
+    return -1;
+  ps->pim = p->pim;
+  ps->sp = p->sp;
+  ps->ts = p->ts;
+  ps->pf = p->pf;
+  ps->cd = p->cd;
+  ps->df = p->df;
+  ps->sh = p->sh;
+  ps->ra = p->ra;
+  ps->rw = p->rw;
+  ps->maxpim = p->maxpim;
+  ps->maxsp = p->maxsp;
+  ps->policy = p->policy ? p->policy->id : -1;
+  ps->gh = p->gh;
+  return 0;
+}
+
+// copy the system wide swap I/O counters to user space.
+int
+sys_swapstat(void)
+{
+  struct swapstat *st, kst;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  if(makeWritable(myproc(), (uint)st, sizeof(*st)) < 0)
+    return -1;
+  swapstat(&kst);
+  *st = kst;
+  return 0;
+}
+
+// copy the buffer cache counters to user space.
+int
+sys_bcstat(void)
+{
+  struct bcstat *st, kst;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  if(makeWritable(myproc(), (uint)st, sizeof(*st)) < 0)
+    return -1;
+  bcachestat(&kst);
+  *st = kst;
+  return 0;
+}
+
+// turn load control on (1) or off (0), or leave it (-1), and copy
+// its state to user space.
+int
+sys_loadctl(void)
+{
+  int on, r;
+  struct loadstat *st, kst;
+
+  if(argint(0, &on) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  if(makeWritable(myproc(), (uint)st, sizeof(*st)) < 0)
+    return -1;
+  if((r = loadctl(on, &kst)) == 0)
+    *st = kst;
+  return r;
+}
+
+// copy the page aging sampler's counters to user space.
+int
+sys_agestat(void)
+{
+  struct agestat *st;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  if(makeWritable(myproc(), (uint)st, sizeof(*st)) < 0)
+    return -1;
+  return agestat(st);
+}
+
+// switch the page replacement policy of a process, or of all.
+int
+sys_setpolicy(void)
+{
+  int id, pid;
+
+  if(argint(0, &id) < 0 || argint(1, &pid) < 0)
+    return -1;
+  return setpolicy(id, pid);
+}
+
+// turn the page fault trace on or off and drain it into the user's
+// buffer of n records, all of which must be user memory.
+int
+sys_pgtrace(void)
+{
+  struct pgtrec *buf;
+  int on, n, *lost;
+
+  if(argint(0, &on) < 0 || argint(2, &n) < 0 || n < 0 || n > KERNBASE / sizeof(*buf) ||
+     argptr(1, (void*)&buf, n * sizeof(*buf)) < 0 || argptr(3, (void*)&lost, sizeof(*lost)) < 0)
+    return -1;
+  if(makeWritable(myproc(), (uint)buf, n * sizeof(*buf)) < 0 ||
+     makeWritable(myproc(), (uint)lost, sizeof(*lost)) < 0)
+    return -1;
+  return pgtrace(on, buf, n, lost);
+}
+
+// power off the machine, for init once the benchmarks of make bench
+// are done: through QEMU's isa-debug-exit device, else its ACPI port.
+int
+sys_halt(void)
+{
+  if(myproc()->pid != 1)
+    return -1;
+  outb(0xf4, 0);
+  outw(0x604, 0x2000);
+  return -1;
+}
+
+// set the resident and swapped page limits of the calling process.
+int
+sys_setpglimit(void)
+{
+  int maxpim, maxsp;
+
+  if(argint(0, &maxpim) < 0 || argint(1, &maxsp) < 0)
+    return -1;
+  #ifdef NONE
+  return -1;
+  #else
+  int r;
+  pagingLock();
+  if((r = setPageLimits(myproc(), maxpim, maxsp)) == 0)
+    myproc()->pinned = 1;     // not moved by PFF any more
+  pagingUnlock();
+  return r;
+  #endif
+}
@@ -0,0 +1,93 @@
+// Page fault trace.
+//
+// While tracing is on, page faults, evictions and swap-ins are logged
+// to a ring of PGTRACE_SIZE records per CPU, so that CPUs faulting at
+// once do not contend; pgtrace() drains the rings.  A full ring drops
+// the newest records and counts them.  Records from different CPUs
+// come out CPU by CPU: sort them by tick to merge.  The pgsim host tool
+// replays a trace through the replacement policies (pgsim.c).
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "pgstat.h"
+
+struct pgtring {
+  struct spinlock lock;
+  struct pgtrec rec[PGTRACE_SIZE];
+  uint head;                    // next record to drain
+  uint tail;                    // next record to log
+  uint lost;                    // records dropped while full
+};
+
+static struct pgtring rings[NCPU];
+static int tracing;
+
+void
+pgtraceinit(void)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    initlock(&rings[i].lock, "pgtrace");
+}
+
+// Log an event of type on page va of process pid.
+void
+pgtraceLog(int pid, uint va, int type)
+{
+  struct pgtring *r;
+
+  if(!tracing)
+    return;
+  pushcli();
+  r = &rings[cpuid()];
+  acquire(&r->lock);
+  if(r->tail - r->head < PGTRACE_SIZE){
+    r->rec[r->tail % PGTRACE_SIZE].tick = ticks;
+    r->rec[r->tail % PGTRACE_SIZE].va = PGROUNDDOWN(va) | type;
+    r->rec[r->tail % PGTRACE_SIZE].pid = pid;
+    r->tail++;
+  } else
+    r->lost++;
+  release(&r->lock);
+  popcli();
+}
+
+// Turn tracing on (1) or off (0), or leave it (-1), and move up to n
+// logged records to user buffer buf, which sys_pgtrace() checked is
+// user memory for n records and made writable.  Returns the records
+// moved, or -1 once tracing is off and none are left; *lost gets the
+// ones dropped since the last call.  The records go through a buffer
+// on the stack, since touching buf may fault it in from swap, which
+// cannot happen under a ring's lock.
+int
+pgtrace(int on, struct pgtrec *buf, int n, int *lost)
+{
+  struct pgtring *r;
+  struct pgtrec rec[16];
+  int k, got = 0, dropped = 0;
+
+  if(on >= 0)
+    tracing = on;
+  for(r = rings; r < &rings[ncpu]; r++){
+    do {
+      acquire(&r->lock);
+      for(k = 0; r->head != r->tail && k < NELEM(rec) && got + k < n; r->head++)
+        rec[k++] = r->rec[r->head % PGTRACE_SIZE];
+      dropped += r->lost;
+      r->lost = 0;
+      release(&r->lock);
+      memmove(buf + got, rec, k * sizeof(rec[0]));
+      got += k;
+    } while(k == NELEM(rec));
+  }
+  *lost = dropped;
+  if(!tracing && n > 0 && got == 0)
+    return -1;
+  return got;
+}
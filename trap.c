@@ -7,12 +7,14 @@
 #include "x86.h"
 #include "traps.h"
 #include "spinlock.h"
+#include "pgstat.h"
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
+uint swapfaults;  // faults that had to swap a page in, system wide
 
 void
 tvinit(void)
@@ -36,9 +38,9 @@ idtinit(void)
 void
 trap(struct trapframe *tf)
 {
+  pte_t* pte;
+  uint va;
   #ifndef NONE
-      pte_t* pte;
-      uint va;
       int swapFileIndex;
   #endif
 
@@ -59,7 +61,23 @@ trap(struct trapframe *tf)
       ticks++;
       wakeup(&ticks);
       release(&tickslock);
+      #if defined(PFF) && !defined(GCLOCK) && !defined(NONE)
+      if(ticks % PFF_WINDOW == 0)
+        pffWake();
+      #endif
+      #ifndef NONE
+      if(ticks % LOAD_WINDOW == 0)
+        loadWake();
+      #endif
     }
+    // CPU utilization, for load control.
+    if(myproc())
+      mycpu()->busy++;
+    else
+      mycpu()->idle++;
+    #ifndef NONE
+    agetick((tf->cs&3) == DPL_USER);
+    #endif
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -84,28 +102,55 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    // Anything not handled here falls through to the default case.
+    // Paging a page in may sleep, so the kernel must not touch user
+    // memory holding a spinlock (see pipewrite()).
+    if(myproc() && (tf->cs&3) == 0 && mycpu()->ncli > 0)
+      panic("page fault holding a spinlock");
+    va = PGROUNDDOWN(rcr2());
+    if(myproc() && (tf->cs&3) == DPL_USER)
+      pgtraceLog(myproc()->pid, va, PGT_FAULT);     // user references only
+    pte = myproc() ? walkpgdir2(myproc()->pgdir, (void*) va) : 0;
+    if(myproc() && (va < myproc()->sz || vmaLookup(myproc(), va)) && (pte == 0 || *pte == 0)){
+      // Executable, heap or mmap() region not touched before.
+      if(demandPage(myproc(), (void*) va) == 0)
+        return;
+      cprintf("pid %d %s: no memory for demand paged page\n",
+              myproc()->pid, myproc()->name);
+      pte = 0;
+    }
+    if(pte)
+      pagingLock();
+    if(pte && (*pte & PTE_P) && (*pte & PTE_COW)){
+      if(copyOnWrite(myproc(), (void*) va) == 0){
+        pagingUnlock();
+        return;
+      }
+      cprintf("pid %d %s: no memory for copy-on-write\n",
+              myproc()->pid, myproc()->name);
+    }
   #ifndef NONE
-    case T_PGFLT:
-      cprintf("Get into the trap\n");
-      va = PGROUNDDOWN(rcr2());
-      cprintf("Get into the trap: the va is: %d\n",va);
-      pte = walkpgdir2(myproc()->pgdir, (void*) va);
-      cprintf("Get into the trap:the pte is %d\n",(uint)*pte);
-      cprintf("Get into the trap:the PTE_PG is %d\n",PTE_PG);
-      cprintf("Get into the trap:the PTE_U is %d\n",PTE_U);
-      if(((uint)*pte) & PTE_PG){
-        cprintf("Get into If\n");
+      else if(pte && (((uint)*pte) & PTE_PG)){
         myproc()->pf++;
-        if(myproc()->pim > MAX_PSYC_PAGES)
+        swapfaults++;
+        if(myproc()->pim > myproc()->maxpim)
           panic("trap: T_PGFLT - memory full");
-        if(myproc()->pim == MAX_PSYC_PAGES){
+        if(myproc()->pim == myproc()->maxpim){
           swapFileIndex = pageSelector(myproc());
           swapAndWrite(swapFileIndex, myproc());
         }
+        #ifdef GCLOCK
+        gclockReclaim(GCLOCK_LOW);
+        #endif
         swapAndRead((void*) va, myproc());
+        readAhead((void*) va, myproc());
+        pagingUnlock();
         return;
       }
     #endif
+    if(pte)
+      pagingUnlock();
 
   //PAGEBREAK: 13
   default:
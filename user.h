@@ -1,5 +1,11 @@
 struct stat;
 struct rtcdate;
+struct pgstat;
+struct swapstat;
+struct bcstat;
+struct agestat;
+struct loadstat;
+struct pgtrec;
 
 // system calls
 int fork(void);
@@ -23,6 +29,18 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int pgstat(struct pgstat*);
+int setpglimit(int, int);
+int swapstat(struct swapstat*);
+int bcstat(struct bcstat*);
+char* mmap(void*, int, int, int, int, int);
+int munmap(void*, int);
+int madvise(void*, int, int);
+int loadctl(int, struct loadstat*);
+int agestat(struct agestat*);
+int setpolicy(int, int);
+int pgtrace(int, struct pgtrec*, int, int*);
+int halt(void);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -6,6 +6,12 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "mman.h"
+#include "pgstat.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
@@ -57,10 +63,9 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   if(*pde & PTE_P){
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
   } else {
-    if(!alloc || (pgtab = (pte_t*)kalloc()) == 0)
-      return 0;
     // Make sure all those PTE_P bits are zero.
-    memset(pgtab, 0, PGSIZE);
+    if(!alloc || (pgtab = (pte_t*)kzalloc()) == 0)
+      return 0;
     // The permissions here are overly generous, but they can
     // be further restricted by the permissions in the page table
     // entries, if necessary.
@@ -137,9 +142,8 @@ setupkvm(void)
   pde_t *pgdir;
   struct kmap *k;
 
-  if((pgdir = (pde_t*)kalloc()) == 0)
+  if((pgdir = (pde_t*)kzalloc()) == 0)
     return 0;
-  memset(pgdir, 0, PGSIZE);
   if (P2V(PHYSTOP) > (void*)DEVSPACE)
     panic("PHYSTOP too high");
   for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
@@ -234,6 +238,8 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
 
 // Allocate page tables and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// Only exec() uses it, on the image it is building: the pages join the
+// process's page details once exec() commits to it (adoptPages()).
 int
 allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
@@ -247,30 +253,21 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    #ifdef GCLOCK
+      gclockReclaim(GCLOCK_LOW);
+    #endif
+    mem = kzalloc();
     if(mem == 0){
       cprintf("allocuvm out of memory\n");
       deallocuvm(pgdir, newsz, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
       cprintf("allocuvm out of memory (2)\n");
       deallocuvm(pgdir, newsz, oldsz);
       kfree(mem);
       return 0;
     }
-
-    #ifndef NONE
-      if(myproc()->pim > MAX_PSYC_PAGES){
-        panic("memory full");
-      }
-      if(myproc()->pim == MAX_PSYC_PAGES){
-        int swapFileIndex = pageSelector(myproc());
-        swapAndWrite(swapFileIndex, myproc());
-      }
-      updatePages((void*) a, mem, myproc());
-    #endif
   }
   return newsz;
 }
@@ -310,14 +307,7 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   #ifndef NONE
       //Checking if the paged out to secondary storage
      else if (*pte & PTE_PG && myproc()->pgdir == pgdir) {
-      int i;
-      for (i = 0; i < MAX_PSYC_PAGES; i++) {
-        if (myproc()->sd[i].va == (char*)a)
-          break;
-      }
-      if (i == MAX_PSYC_PAGES || myproc()->sd[i].inSF == 0)
-          panic("error - deallocuvm fuinction - Paged not out to secondary storage");
-      myproc()->sd[i].inSF = 0;     
+      releaseSwapSlot(sdLookup(myproc(), *pte, (char*)a), myproc());
       myproc()->sp--;
       *pte = 0;
     }
@@ -359,7 +349,11 @@ clearpteu(pde_t *pgdir, char *uva)
 }
 
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child.  With COW the child shares the
+// parent's frames: writable pages become read-only
+// PTE_COW pages in both tables and are copied on the
+// first write fault (see copyOnWrite).  The caller must
+// flush the parent's TLB.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
@@ -367,24 +361,46 @@ copyuvm(pde_t *pgdir, uint sz)
   pte_t *pte;
   pte_t * pte2level;
   uint pa, i, flags;
+#ifndef COW
   char *mem;
+#endif
 
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+    // Demand-zero heap pages not touched yet stay so in the child.
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    if(*pte == 0)
+      continue;
     if(*pte & PTE_PG){
-      pte2level = walkpgdir(d, (void *) i, 1);
-      flags = PTE_FLAGS(*pte);                         //copy the parent flags
-      *pte2level = PTE_U | PTE_PG | PTE_W | PTE_ADDR(*pte) | (int) flags;     //update the flags
-      *pte2level = *pte2level & ~PTE_P;              //clear the PTE_P flag
+      // Same swap details index and permissions as the parent's.
+      if((pte2level = walkpgdir(d, (void *) i, 1)) == 0)
+        goto bad;
+      *pte2level = *pte;
       continue;
     }
+    if(!(*pte & PTE_P))
+      panic("copyuvm: page not present");
     pa = PTE_ADDR(*pte);
+#ifdef COW
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
+    flags = PTE_FLAGS(*pte);
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
+      goto bad;
+    kref(P2V(pa));
+#else
     flags = PTE_FLAGS(*pte);
+    if(*pte & PTE_COW){
+      // From the page cache: shared by every process running the binary.
+      if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
+        goto bad;
+      kref(P2V(pa));
+      continue;
+    }
     if((mem = kalloc()) == 0)
       goto bad;
     memmove(mem, (char*)P2V(pa), PGSIZE);
@@ -392,6 +408,7 @@ copyuvm(pde_t *pgdir, uint sz)
       kfree(mem);
       goto bad;
     }
+#endif
   }
   return d;
 
@@ -400,6 +417,250 @@ bad:
   return 0;
 }
 
+// A zeroed frame for demandPage(), taken from the page cache's
+// unshared frames if memory has run out.
+static char*
+demandFrame(void)
+{
+  char *mem;
+
+  if((mem = kzalloc()) == 0 && pcachereclaim())
+    mem = kzalloc();
+  return mem;
+}
+
+// Map the page at va, below p->sz or in an mmap() region, not touched
+// yet (or dropped clean since): read from the executable if it lies in
+// one of its segments or from the mapped file, zeroed otherwise (heap
+// grown by growproc(), bss, anonymous regions).  The file is read
+// before taking the paging lock, since a process holding the inode
+// lock may itself be waiting for the paging lock.  Executable
+// pages go through the page cache: they are mapped copy-on-write from
+// a frame shared with every process running the same binary, and are
+// not counted in pim until a write gives the process its own copy.
+// Returns -1 if there is no memory (or swap room) for it.
+int
+demandPage(struct proc *p, void *va)
+{
+  char *mem, *page;
+  pte_t *pte;
+  struct execseg *s;
+  struct vma *v = 0;
+  uint n, off, flags;
+  int r, shared;
+
+  if((uint)va >= p->sz && (v = vmaLookup(p, (uint)va)) == 0)
+    return -1;
+  mem = 0;
+  shared = 0;
+  flags = PTE_W|PTE_U|PTE_DZ;
+  if(v && !(v->prot & PROT_WRITE))
+    flags &= ~PTE_W;
+  if(v && v->f){
+    if((mem = demandFrame()) == 0)
+      return -1;
+    off = v->off + ((uint)va - v->start);
+    ilock(v->f->ip);
+    n = off >= v->f->ip->size ? 0 :
+        (v->f->ip->size - off < PGSIZE ? v->f->ip->size - off : PGSIZE);
+    r = n ? readi(v->f->ip, mem, off, n) : 0;
+    iunlock(v->f->ip);
+    if(r != n){
+      kfree(mem);
+      return -1;
+    }
+  }
+  for(s = p->seg; v == 0 && s < &p->seg[p->nseg]; s++){
+    if((uint)va < s->va || (uint)va >= s->va + s->memsz)
+      continue;
+    n = (uint)va - s->va;
+    n = n >= s->filesz ? 0 : (s->filesz - n < PGSIZE ? s->filesz - n : PGSIZE);
+    if(n == 0)
+      break;
+    off = s->off + ((uint)va - s->va);
+    if((mem = pcacheget(p->exe, off, n)) != 0){
+      shared = 1;
+      break;
+    }
+    if((mem = demandFrame()) == 0)
+      return -1;
+    ilock(p->exe);
+    r = readi(p->exe, mem, off, n);
+    iunlock(p->exe);
+    if(r != n){
+      kfree(mem);
+      return -1;
+    }
+    if((page = pcacheput(p->exe, off, n, mem)) != 0){
+      if(page != mem)
+        kfree(mem);
+      mem = page;
+      shared = 1;
+    }
+    break;
+  }
+  if(mem == 0 && (mem = demandFrame()) == 0)
+    return -1;
+
+  pagingLock();
+  r = -1;
+  pte = walkpgdir(p->pgdir, va, 0);
+  if(pte && *pte){
+    r = 0;    // mapped meanwhile
+    goto out;
+  }
+  if(shared){
+    if(mappages(p->pgdir, va, PGSIZE, V2P(mem), PTE_U|PTE_COW|PTE_DZ) < 0)
+      goto out;
+    mem = 0;
+    p->sh++;
+    p->df++;
+    r = 0;
+    goto out;
+  }
+  if(v && (v->flags & MAP_SHARED)){
+    // Not paged, so that fork children can share it (see mmap.c).
+    if(mappages(p->pgdir, va, PGSIZE, V2P(mem), flags) < 0)
+      goto out;
+    mem = 0;
+    p->df++;
+    r = 0;
+    goto out;
+  }
+  #ifndef NONE
+    if(p->pim == p->maxpim && p->sp >= p->maxsp)
+      goto out;
+  #endif
+  #ifdef GCLOCK
+    gclockReclaim(GCLOCK_LOW);
+  #endif
+  if(mappages(p->pgdir, va, PGSIZE, V2P(mem), flags) < 0)
+    goto out;
+  #ifndef NONE
+    page = mem;
+  #endif
+  mem = 0;
+  #ifndef NONE
+    if(p->pim == p->maxpim)
+      swapAndWrite(pageSelector(p), p);
+    updatePages(va, page, p);
+  #endif
+  p->df++;
+  r = 0;
+out:
+  pagingUnlock();
+  if(mem)
+    kfree(mem);
+  return r;
+}
+
+// Give p a private, writable copy of the copy-on-write
+// page at va after a write fault.  The last process still
+// sharing the frame takes it over without copying.  A page
+// mapped from the page cache is not in p's page details yet
+// and joins them here.  Returns -1 if va is not a copy-on-write
+// page or there is no memory (or swap room) for the copy.
+int
+copyOnWrite(struct proc *p, void *va)
+{
+  pte_t *pte;
+  uint pa, flags;
+  char *mem;
+
+  pte = walkpgdir(p->pgdir, va, 0);
+  if(pte == 0 || !(*pte & PTE_P) || !(*pte & PTE_COW))
+    return -1;
+  #ifndef NONE
+    int tracked = pdLookup(p, va) >= 0;
+    if(!tracked && p->pim == p->maxpim && p->sp >= p->maxsp)
+      return -1;
+  #endif
+  #ifdef GCLOCK
+    if(!tracked)
+      gclockReclaim(GCLOCK_LOW);
+  #endif
+  pa = PTE_ADDR(*pte);
+  flags = (PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW;
+  if(krefcount(P2V(pa)) > 1){
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, (char*)P2V(pa), PGSIZE);
+    *pte = V2P(mem) | flags;
+    kfree(P2V(pa));
+    #ifndef NONE
+      if(tracked)
+        replacePage(va, mem, p);
+    #endif
+  } else {
+    mem = P2V(pa);
+    *pte = pa | flags;
+  }
+  #ifndef NONE
+    if(!tracked){
+      if(p->pim == p->maxpim)
+        swapAndWrite(pageSelector(p), p);
+      updatePages(va, mem, p);
+    }
+  #endif
+  lcr3(V2P(p->pgdir));
+  return 0;
+}
+
+// Check that a system call may write the pages of p in [va, va+n).
+// Every system call that fills a user buffer calls this after argptr().
+// Returns -1 if one of the pages is read-only (mmap() without
+// PROT_WRITE): a kernel-mode write to it is not copy-on-write, so the
+// fault would fall to trap()'s default case and panic.  Copy-on-write
+// pages are broken here too, although CR0_WP makes a kernel write to
+// one fault into copyOnWrite() anyway.  Swapped out pages are left be.
+int
+makeWritable(struct proc *p, uint va, uint n)
+{
+  uint a;
+  pte_t *pte;
+  int r = 0;
+
+  pagingLock();
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    pte = walkpgdir2(p->pgdir, (void*)a);
+    if(pte && (*pte & PTE_PG) && !(*pte & PTE_W))
+      r = -1;     // read-only, swapped out
+    if(pte == 0 || !(*pte & PTE_P) || (*pte & PTE_W))
+      continue;
+    if(!(*pte & PTE_COW) || copyOnWrite(p, (void*)a) < 0)
+      r = -1;
+  }
+  pagingUnlock();
+  return r;
+}
+
+// Copy the page at va of page table pgdir to buf if it may no longer
+// match what demandPage() would map: written, or swapped out since.
+// pgdir is p's, or the one exec() has just replaced, whose swap details
+// are gone; that case only reads resident pages.  Returns 0, leaving buf
+// alone, if it is not mapped or still clean.
+int
+pageContents(struct proc *p, pde_t *pgdir, uint va, char *buf)
+{
+  pte_t *pte;
+  int r = 0;
+
+  pagingLock();
+  pte = walkpgdir2(pgdir, (void*)va);
+  if(pte && (*pte & PTE_P) && (*pte & (PTE_DZ | PTE_D)) != PTE_DZ){
+    memmove(buf, P2V(PTE_ADDR(*pte)), PGSIZE);
+    r = 1;
+  }
+  #ifndef NONE
+  else if(pgdir == p->pgdir && pte && (*pte & PTE_PG)){
+    swapread(sdLookup(p, *pte, (void*)va)->slot, buf);
+    r = 1;
+  }
+  #endif
+  pagingUnlock();
+  return r;
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
@@ -441,138 +702,698 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
   return 0;
 }
 
-// writing to the swap file
+// Find and set the lowest clear bit of a bitmap of nbits bits.
+// Returns the bit index, or -1 if every bit is set.
+int
+bitmapAlloc(uint *map, int nbits)
+{
+  int i, b;
+
+  for(i = 0; i < BITMAPSZ(nbits); i++){
+    if(map[i] == 0xffffffff)
+      continue;
+    b = i*32 + bsf(~map[i]);
+    if(b >= nbits)
+      break;
+    map[i] |= 1 << (b % 32);
+    return b;
+  }
+  return -1;
+}
+
 void
-swapAndWrite(int pageNum, struct  proc *p){
-  uint location;
-  int count,i;
-  struct sDet *sd;
-  pte_t *pte = walkpgdir(p->pgdir, p->pd[pageNum].va,0);
-  if(!*pte){
-    panic("error - no page table entry");
+bitmapFree(uint *map, int b)
+{
+  map[b / 32] &= ~(1 << (b % 32));
+}
+
+// Paging lock.  The reclaim thread, and under GCLOCK any process,
+// may page out another process's frames, so everything that changes
+// a process's pages, page details or swap file runs under one sleep
+// lock.  With paging off these do nothing.
+struct sleeplock paginglock;
+
+void
+paginginit(void)
+{
+  initsleeplock(&paginglock, "paging");
+}
+
+void
+pagingLock(void)
+{
+  #ifndef NONE
+  acquiresleep(&paginglock);
+  #endif
+}
+
+void
+pagingUnlock(void)
+{
+  #ifndef NONE
+  releasesleep(&paginglock);
+  #endif
+}
+
+// Page and swap details tables (see proc.h).
+
+typedef char pdChunkFits[sizeof(struct pdChunk) <= PGSIZE ? 1 : -1];
+typedef char sdChunkFits[sizeof(struct sdChunk) <= PGSIZE ? 1 : -1];
+typedef char pdDirFits[sizeof(struct pdDir) <= PGSIZE ? 1 : -1];
+typedef char sdDirFits[sizeof(struct sdDir) <= PGSIZE ? 1 : -1];
+
+// Number of page details entries that can be addressed with PD().
+int
+pdSize(struct proc *p)
+{
+  int n;
+
+  if(p->pdt == 0)
+    return 0;
+  n = p->pdt->nchunk * PDCHUNK;
+  return n < p->maxpim ? n : p->maxpim;
+}
+
+// Number of swap details entries that can be addressed with SD().
+int
+sdSize(struct proc *p)
+{
+  int n;
+
+  if(p->sdt == 0)
+    return 0;
+  n = p->sdt->nchunk * SDCHUNK;
+  return n < p->maxsp ? n : p->maxsp;
+}
+
+// Claim the lowest free page details entry below p->maxpim,
+// allocating table pages as needed.  Returns -1 if there is none.
+static int
+pdAlloc(struct proc *p)
+{
+  struct pdChunk *c;
+  int i, n, b;
+
+  if(p->pdt == 0){
+    if((p->pdt = (struct pdDir*)kalloc()) == 0)
+      return -1;
+    memset(p->pdt, 0, PGSIZE);
+    for(i = 0; i < PDHASH; i++)
+      p->pdt->hash[i] = -1;
   }
-  else{
-    for(sd = p->sd,count = 0; sd < &p->sd[MAX_PSYC_PAGES];sd++){
-      if(!sd->inSF){
-        break;
-      }
-      count++;
+  for(i = 0; i < PDDIRSZ && i * PDCHUNK < p->maxpim; i++){
+    if(i == p->pdt->nchunk){
+      if((c = (struct pdChunk*)kalloc()) == 0)
+        return -1;
+      memset(c, 0, PGSIZE);
+      p->pdt->chunk[p->pdt->nchunk++] = c;
     }
-    if (sd >= &p->sd[MAX_PSYC_PAGES]){
-      panic("Swap File is Full");
+    n = p->maxpim - i * PDCHUNK;
+    if((b = bitmapAlloc(p->pdt->chunk[i]->map, n < PDCHUNK ? n : PDCHUNK)) >= 0)
+      return i * PDCHUNK + b;
+  }
+  return -1;
+}
+
+static void
+pdFree(struct proc *p, int i)
+{
+  bitmapFree(p->pdt->chunk[i / PDCHUNK]->map, i % PDCHUNK);
+}
+
+// Claim the lowest free swap details entry below p->maxsp.
+static int
+sdAlloc(struct proc *p)
+{
+  struct sdChunk *c;
+  int i, n, b;
+
+  if(p->sdt == 0){
+    if((p->sdt = (struct sdDir*)kalloc()) == 0)
+      return -1;
+    memset(p->sdt, 0, PGSIZE);
+  }
+  for(i = 0; i < SDDIRSZ && i * SDCHUNK < p->maxsp; i++){
+    if(i == p->sdt->nchunk){
+      if((c = (struct sdChunk*)kalloc()) == 0)
+        return -1;
+      memset(c, 0, PGSIZE);
+      p->sdt->chunk[p->sdt->nchunk++] = c;
     }
-    location = count*PGSIZE;
-    int qPGSIZE = PGSIZE/4;
-    for (i=0; i<4; i++){
-      writeToSwapFile(p,p->pd[pageNum].page + (i * qPGSIZE), location + (i * qPGSIZE), qPGSIZE);  //writeToSwapFile(proc *p,char * buffer,uint fileOffset,uint size)
+    n = p->maxsp - i * SDCHUNK;
+    if((b = bitmapAlloc(p->sdt->chunk[i]->map, n < SDCHUNK ? n : SDCHUNK)) >= 0)
+      return i * SDCHUNK + b;
+  }
+  return -1;
+}
+
+static void
+sdFree(struct proc *p, int i)
+{
+  bitmapFree(p->sdt->chunk[i / SDCHUNK]->map, i % SDCHUNK);
+}
+
+// Index of the resident page va in p's page details, or -1.
+int
+pdLookup(struct proc *p, void *va)
+{
+  int i;
+
+  if(p->pdt == 0)
+    return -1;
+  for(i = p->pdt->hash[PDHASHVA(va)]; i >= 0; i = PD(p, i)->hnext)
+    if(PD(p, i)->va == va)
+      return i;
+  return -1;
+}
+
+static void
+pdHashInsert(struct proc *p, int i)
+{
+  int *b = &p->pdt->hash[PDHASHVA(PD(p, i)->va)];
+
+  PD(p, i)->hnext = *b;
+  *b = i;
+}
+
+static void
+pdHashRemove(struct proc *p, int i)
+{
+  int *b;
+
+  for(b = &p->pdt->hash[PDHASHVA(PD(p, i)->va)]; *b >= 0; b = &PD(p, *b)->hnext){
+    if(*b == i){
+      *b = PD(p, i)->hnext;
+      return;
     }
-    sd->va = p->pd[count].va;     //Update the virtual address
-    sd->inSF = 1;                 //Update the InSwapFile flag
-    kfree(p->pd[count].page);     //Free the page from the memory
-    removePageAndUpdate(p->pd[count].va,p);  //*************************
-    p->sp++;            //increase the Swap Page counter of the process
-    p->ts++;            //increase the Total Swap Page counter of the process
-    *pte = (*pte | PTE_PG) & ~PTE_P;      //**************************
-    lcr3(V2P(p->pgdir));            // By using the LCR3 rgister and the V2P funcation we update the Page Directory 
   }
+  panic("pdHashRemove");
 }
 
+// The swap details entry of a swapped out PTE of p.
+struct sDet*
+sdLookup(struct proc *p, pte_t pte, void *va)
+{
+  struct sDet *sd;
 
-// Returns the index of the page to to be removed, according to the different page replacement scheme.
+  if(!(pte & PTE_PG) || SDINDEX(pte) >= sdSize(p))
+    panic("sdLookup: not a swapped out page");
+  sd = SD(p, SDINDEX(pte));
+  if(!sd->inSF || sd->loaded || sd->va != va)
+    panic("sdLookup: stale entry");
+  return sd;
+}
+
+// Empty page and swap details, for a new process or a new image.
+// The limits are kept.  Table pages already allocated are cleared
+// rather than freed, since the scheduler may be scanning them.
+void
+initPageDetails(struct proc *p)
+{
+  int i;
+
+  p->pim = 0;
+  p->sp = 0;
+  p->ts = 0;
+  p->pf = 0;
+  p->cd = 0;
+  p->df = 0;
+  p->sh = 0;
+  p->ra = 0;
+  p->rw = 0;
+  p->ralast = 0;
+  p->rastride = 0;
+  p->rawin = 0;
+  p->ranext = 0;
+  p->advstart = p->advend = 0;
+  p->advice = MADV_NORMAL;
+  p->seqva = 0;
+  p->pffmark = 0;
+  p->pffrate = 0;
+  p->ws = 0;
+  p->head = 0;
+  memset(p->hand, 0, sizeof(p->hand));
+  memset(p->nlist, 0, sizeof(p->nlist));
+  p->target = 0;
+  p->stamp = 0;
+  p->evicts = 0;
+  p->gh = 0;
+  if(p->pdt){
+    for(i = 0; i < p->pdt->nchunk; i++)
+      memset(p->pdt->chunk[i], 0, PGSIZE);
+    for(i = 0; i < PDHASH; i++)
+      p->pdt->hash[i] = -1;
+  }
+  if(p->sdt)
+    for(i = 0; i < p->sdt->nchunk; i++)
+      memset(p->sdt->chunk[i], 0, PGSIZE);
+}
+
+// Free the table pages of p's page and swap details, once p can
+// no longer be scheduled.
+void
+freePageDetails(struct proc *p)
+{
+  int i;
+
+  if(p->pdt){
+    for(i = 0; i < p->pdt->nchunk; i++)
+      kfree((char*)p->pdt->chunk[i]);
+    kfree((char*)p->pdt);
+    p->pdt = 0;
+  }
+  if(p->sdt){
+    for(i = 0; i < p->sdt->nchunk; i++)
+      kfree((char*)p->sdt->chunk[i]);
+    kfree((char*)p->sdt);
+    p->sdt = 0;
+  }
+}
+
+// Give a fork child copies of the parent's page and swap details
+// and limits.  Returns -1 if there is no memory for the tables.
 int
-pageSelector(struct proc *p){
-  int ans = -1;
-  // NFU + AGING
-  // Find the page that is 'accCount' var is the lowest. 
-  #ifdef NFUA
-    uint lowest = 0xffffffff;
-    for(int i = 0 ; i < MAX_PSYC_PAGES ; i++){
-      if(!p->pd[i].inMem ){
-        panic("error - page is not in memory");
+copyPageDetails(struct proc *parent, struct proc *child)
+{
+  int i;
+
+  child->maxpim = parent->maxpim;
+  child->maxsp = parent->maxsp;
+  child->pinned = parent->pinned;
+  child->pim = parent->pim;
+  child->sp = parent->sp;
+  child->head = parent->head;
+  memmove(child->hand, parent->hand, sizeof(child->hand));
+  memmove(child->nlist, parent->nlist, sizeof(child->nlist));
+  child->target = parent->target;
+  child->stamp = parent->stamp;
+  child->evicts = parent->evicts;
+  child->advstart = parent->advstart;
+  child->advend = parent->advend;
+  child->advice = parent->advice;
+  child->seqva = parent->seqva;
+  child->policy = parent->policy;
+  if(parent->pdt){
+    if((child->pdt = (struct pdDir*)kalloc()) == 0)
+      return -1;
+    memmove(child->pdt, parent->pdt, PGSIZE);
+    for(i = 0; i < parent->pdt->nchunk; i++){
+      if((child->pdt->chunk[i] = (struct pdChunk*)kalloc()) == 0){
+        child->pdt->nchunk = i;
+        return -1;
       }
-      pte_t* pte = walkpgdir2(p->pgdir, p->pd[i].va);
-      if(!(*pte & PTE_U)){
-        continue;
+      memmove(child->pdt->chunk[i], parent->pdt->chunk[i], PGSIZE);
+    }
+    // The cached PTEs are the parent's.
+    for(i = 0; i < pdSize(child); i++)
+      if(PD(child, i)->inMem)
+        PD(child, i)->pte = walkpgdir2(child->pgdir, PD(child, i)->va);
+    #ifdef GCLOCK
+    // Frames copied for the child join the frame table; frames shared
+    // copy-on-write stay the parent's until one side copies.
+    pte_t *pte;
+    for(i = 0; i < pdSize(child); i++){
+      if(PD(child, i)->inMem && (pte = PD(child, i)->pte) &&
+         (*pte & PTE_P) && krefcount(P2V(PTE_ADDR(*pte))) == 1){
+        PD(child, i)->page = P2V(PTE_ADDR(*pte));
+        kframeset(PD(child, i)->page, child, PD(child, i)->va);
       }
-      if(p->pd[i].accCount <= lowest){
-        lowest = p->pd[i].accCount;
-        ans = i;
+    }
+    #endif
+  }
+  if(parent->sdt){
+    if((child->sdt = (struct sdDir*)kalloc()) == 0)
+      return -1;
+    memmove(child->sdt, parent->sdt, PGSIZE);
+    for(i = 0; i < parent->sdt->nchunk; i++){
+      if((child->sdt->chunk[i] = (struct sdChunk*)kalloc()) == 0){
+        child->sdt->nchunk = i;
+        return -1;
       }
+      memmove(child->sdt->chunk[i], parent->sdt->chunk[i], PGSIZE);
     }
+  }
+  return 0;
+}
+
+// Set p's resident and swapped page limits; 0 keeps a limit as it is.
+// Lowering the resident limit pages out the excess.  Returns -1 if
+// a limit is out of range or the pages do not fit in the new limits.
+int
+setPageLimits(struct proc *p, int maxpim, int maxsp)
+{
+  int i;
+
+  if(maxpim == 0)
+    maxpim = p->maxpim;
+  if(maxsp == 0)
+    maxsp = p->maxsp;
+  if(maxpim < MIN_PSYC_PAGES || maxpim > PDDIRSZ * PDCHUNK ||
+     maxsp < 0 || maxsp > NSWAPSLOTS)
+    return -1;
+  // Swap details numbers are kept in the PTEs, so they cannot move;
+  // clean copies of resident pages can just be dropped.
+  for(i = 0; i < pdSize(p); i++)
+    if(PD(p, i)->inMem && PD(p, i)->sdi >= maxsp)
+      dropSwapCopy(p, i);
+  for(i = maxsp; i < sdSize(p); i++)
+    if(SD(p, i)->inSF)
+      return -1;
+  if(p->pim > maxpim && p->pim - maxpim > maxsp - p->sp)
+    return -1;
+
+  p->maxsp = maxsp;
+  #ifndef NONE
+  while(p->pim > maxpim)
+    swapAndWrite(pageSelector(p), p);
   #endif
+  // Page details numbers must stay below the limit: move the
+  // entries above it down to free ones.
+  for(i = maxpim; i < pdSize(p); i++)
+    if(PD(p, i)->inMem && pdMoveDown(p, i) >= maxpim)
+      panic("setPageLimits");
+  p->maxpim = maxpim;
+  if(p->head >= maxpim)
+    p->head = 0;
+  return 0;
+}
 
-  // Leaset accesed page + AGING
-  // Find the page with the lowest 1's in 'accCount',
-  // if the number of 1 in 'accCount' is equale, then take the the lowest 'accCount'
-  #ifdef LAPA
-  uint minNumberOf1 = 33;
-  uint lowest = 0xffffffff;
-  for(int i = 0 ; i < MAX_PSYC_PAGES ; i++){
-    if(!p->pd[i].inMem){
-      panic("error - page not in memory");
-    }
-    pte_t* pte = walkpgdir2(p->pgdir, p->pd[i].va);
-    if(!(*pte & PTE_U)){
-      continue;
-    }
-    uint currentaccCount = p->pd[i].accCount;
-    int countNumOf1 = 0;
-    while(currentaccCount) {
-        countNumOf1 += currentaccCount % 2;   
-        currentaccCount >>= 1;
-    }
+// Move resident page details entry i of p to the lowest free entry,
+// which must be below it.  Returns the new number.
+int
+pdMoveDown(struct proc *p, int i)
+{
+  int j;
+
+  if((j = pdAlloc(p)) < 0 || j > i)
+    panic("pdMoveDown");
+  pdHashRemove(p, i);
+  *PD(p, j) = *PD(p, i);
+  PD(p, i)->inMem = 0;
+  PD(p, i)->va = 0;
+  pdFree(p, i);
+  pdHashInsert(p, j);
+  return j;
+}
 
-    if(countNumOf1 < minNumberOf1 || (countNumOf1 == minNumberOf1 && p->pd[i].accCount <= lowest)){
-      lowest = p->pd[i].accCount;
-      minNumberOf1 = countNumOf1;
-      ans = i;
+// Free page details entry i of p, whose page left memory.
+void
+pdRelease(struct proc *p, int i)
+{
+  pdHashRemove(p, i);
+  PD(p, i)->inMem = 0;
+  PD(p, i)->va = 0;
+  pdFree(p, i);
+  p->pim--;
+}
+
+// Drop the clean swap copy of resident page i of p.
+void
+dropSwapCopy(struct proc *p, int i)
+{
+  struct sDet *sd = SD(p, PD(p, i)->sdi);
+
+  sd->loaded = 0;
+  releaseSwapSlot(sd, p);
+  PD(p, i)->sdi = -1;
+}
+
+// Drop some clean swap copy to make room for a page that has to be
+// written.  Returns 0 if there is none.
+static int
+reclaimSwapCopy(struct proc *p)
+{
+  int i;
+
+  for(i = 0; i < pdSize(p); i++){
+    if(PD(p, i)->inMem && PD(p, i)->sdi >= 0){
+      dropSwapCopy(p, i);
+      return 1;
     }
   }
-  #endif
+  return 0;
+}
 
-  // Second chance FIFO
-  // Find the first page (FIFO) that its PTE_A is 0.
-  #ifdef SCFIFO
-    int accessed = 1;
+// Pages swapOut() queued for one batched write by swapFlush().
+struct swapbatch {
+  int n;
+  uint slot[SWAPBATCH];
+  char *pg[SWAPBATCH];
+};
 
-    //loop unntil we find a page which wan't accessed.
-    while(accessed) {
-      if(!p->pd[p->head].inMem){
-        panic("error - page not in memory");
-      }
-      pte_t* pte = walkpgdir2(p->pgdir, p->pd[p->head].va);
-      if(!(*pte & PTE_U)){
-        p->head = (p->head + 1) % MAX_PSYC_PAGES;
-        continue;
-      }
-      accessed = *pte & PTE_A;                      
-      *pte = *pte & ~PTE_A;
-      p->head = (p->head + 1) % MAX_PSYC_PAGES;
+// writing to the swap file
+// A page that still has a clean copy in swap (loaded from it and
+// not written since, PTE_D clear) is just dropped.  With a batch b
+// the write, and freeing the frame, are left to swapFlush(); the page
+// is marked to be swapped back in by swapInSuspended().
+static void
+swapOut(int pageNum, struct proc *p, struct swapbatch *b){
+  int index, slot, queued = 0;
+  uint flags;
+  struct sDet *sd;
+  char *va = PD(p, pageNum)->va;
+  pte_t *pte = walkpgdir(p->pgdir, va, 0);
+  pgtraceLog(p->pid, (uint)va, PGT_EVICT);
+  if(!pte || !*pte){
+    panic("error - no page table entry");
+  }
+  else{
+    // The frame may be shared copy-on-write, so take it from the PTE.
+    char *page = P2V(PTE_ADDR(*pte));
+    if(PD(p, pageNum)->ra && !(*pte & PTE_A)){
+      p->rw++;                    //read ahead for nothing: shrink the window
+      p->rawin /= 2;
     }
-    //return the first page that wasn't accessed (we go back -1 because of the loop) 
-    ans = (p->head + MAX_PSYC_PAGES - 1) % MAX_PSYC_PAGES;
-  #endif
-
-  // Advancing Queue
-  #ifdef AQ
-    int i;
-    for(i = 0 ; i < MAX_PSYC_PAGES ; i++){
-      if(!p->pd[i].inMem){
-        panic("error - page not in memory");
-      }
+    if((*pte & (PTE_DZ | PTE_D)) == PTE_DZ && PD(p, pageNum)->sdi < 0){
+      // Never written: demandPage() brings it back from the
+      // executable or zeroed.
+      kfree(page);
+      removePageAndUpdate(va, p);
+      *pte = 0;
+      p->cd++;
+      if(p == myproc())
+        lcr3(V2P(p->pgdir));
+      return;
+    }
+    if(PD(p, pageNum)->sdi >= 0 && !(*pte & PTE_D)){
+      index = PD(p, pageNum)->sdi;
+      PD(p, pageNum)->sdi = -1;
+      sd = SD(p, index);
+      sd->loaded = 0;
+      p->cd++;
+    } else {
+      if(PD(p, pageNum)->sdi >= 0)
+        dropSwapCopy(p, pageNum);
+      while((index = sdAlloc(p)) < 0)
+        if(!reclaimSwapCopy(p))
+          panic("Swap File is Full");
+      while((slot = swapalloc()) < 0)
+        if(!reclaimSwapCopy(p))
+          panic("Swap area is full");
+      sd = SD(p, index);
+      if(b){
+        b->slot[b->n] = slot;
+        b->pg[b->n++] = page;
+        queued = 1;
+      } else
+        swapwrite(slot, page);      //one whole-page transfer to the swap area
+      sd->va = va;                  //Update the virtual address
+      sd->slot = slot;
+      sd->inSF = 1;                 //Update the InSwapFile flag
     }
+    sd->adv = PD(p, pageNum)->adv;
+    sd->susp = b != 0;
+    // Its ghost, for the policies that learn from swap-in faults on
+    // pages they evicted lately (policy.c); not when load control
+    // pages out the whole process.
+    sd->ghost = b ? 0 : ++p->evicts;
+    sd->glist = PD(p, pageNum)->list;
+    if(!queued)
+      kfree(page);                //Free the page from the memory
+    removePageAndUpdate(va,p);
+    p->sp++;            //increase the Swap Page counter of the process
+    p->ts++;            //increase the Total Swap Page counter of the process
+    // Keep its permissions for swappedIn(): a copy-on-write page is
+    // writable once it has a frame of its own.  Not PTE_DZ: what comes
+    // back from swap need not match what demandPage() would map.
+    flags = PTE_FLAGS(*pte);
+    if(flags & PTE_COW)
+      flags |= PTE_W;
+    *pte = (index << PTXSHIFT) | ((flags | PTE_PG) & ~(PTE_P | PTE_COW | PTE_D | PTE_DZ));
+    if(p == myproc())
+      lcr3(V2P(p->pgdir));            // By using the LCR3 rgister and the V2P funcation we update the Page Directory 
+  }
+}
 
-    for(i = 0 ; i < MAX_PSYC_PAGES ; i++){
-      pte_t* pte = walkpgdir2(p->pgdir, p->pd[i].va);
-      if((*pte & PTE_U)){
+void
+swapAndWrite(int pageNum, struct proc *p){
+  swapOut(pageNum, p, 0);
+}
+
+// Take the resident pages below sz of the image exec() has just made
+// p's own into p's emptied page details, paging out as faults would
+// to stay within the resident limit.  Pages past both limits stay
+// resident, untracked.  Called with the paging lock held.
+void
+adoptPages(struct proc *p, uint sz){
+  pte_t *pte;
+  uint a;
+
+  for(a = 0; a < sz; a += PGSIZE){
+    if((pte = walkpgdir2(p->pgdir, (void*)a)) == 0 || !(*pte & PTE_P))
+      continue;
+    if(p->pim == p->maxpim){
+      if(p->sp >= p->maxsp)
         break;
-      }
+      swapAndWrite(pageSelector(p), p);
     }
-    ans = i;
-  #endif
+    updatePages((void*)a, P2V(PTE_ADDR(*pte)), p);
+  }
+}
+
+// Write the pages queued in b and free their frames.
+static void
+swapFlush(struct swapbatch *b)
+{
+  int i;
+
+  swapwritev(b->slot, b->pg, b->n);
+  for(i = 0; i < b->n; i++)
+    kfree(b->pg[i]);
+  b->n = 0;
+}
+
+// Page out all of p's resident pages, as far as its swap limit
+// allows, for the load control swapper: the writes go out SWAPBATCH
+// at a time with their requests in flight together.  Returns the
+// pages paged out.  Called with the paging lock held; p must not be
+// running.
+int
+swapOutAll(struct proc *p)
+{
+  struct swapbatch b;
+  int i, n = 0;
+
+  b.n = 0;
+  while(p->pim > 0 && p->sp < p->maxsp){
+    // removePageAndUpdate() may move the entries (AQ), so look for
+    // a resident page from the start every time.
+    for(i = 0; i < pdSize(p) && !PD(p, i)->inMem; i++)
+      ;
+    if(i == pdSize(p))
+      break;
+    swapOut(i, p, &b);
+    n++;
+    if(b.n == SWAPBATCH)
+      swapFlush(&b);
+  }
+  if(b.n > 0)
+    swapFlush(&b);
+  return n;
+}
+
+// Drop p's use of the swap slot held by sd.
+void
+releaseSwapSlot(struct sDet *sd, struct proc *p){
+  int i;
+  if(!sd->inSF)
+    panic("releaseSwapSlot");
+  swapfree(sd->slot);
+  sd->inSF = 0;
+  sd->loaded = 0;
+  sd->va = 0;
+  for(i = 0; i < p->sdt->nchunk; i++)
+    if(sd >= p->sdt->chunk[i]->e && sd < &p->sdt->chunk[i]->e[SDCHUNK])
+      sdFree(p, i * SDCHUNK + (sd - p->sdt->chunk[i]->e));
+}
+
+// Release every swap slot of p, before its swap file goes away.
+void
+releaseSwapSlots(struct proc *p){
+  int i;
+  for(i = 0; i < sdSize(p); i++)
+    if(SD(p, i)->inSF)
+      releaseSwapSlot(SD(p, i), p);
+}
+
+// Share the parent's swapped out pages with a copy-on-write child,
+// whose swap details were copied by copyPageDetails().  Both processes
+// read the same slots until each one swaps the page in.
+void
+shareSwapSlots(struct proc *child){
+  int i;
+  struct sDet *sd;
+  for(i = 0; i < sdSize(child); i++){
+    sd = SD(child, i);
+    if(sd->inSF)
+      swapdup(sd->slot);
+  }
+}
+
+// Give an eagerly copied fork child its own copy of every slot named
+// in its swap details, copied by copyPageDetails().  Returns -1, with
+// the entries not copied cleared, if the swap area or memory runs out.
+int
+copySwapSlots(struct proc *child){
+  int i, slot;
+  char *buf;
+  struct sDet *sd;
+
+  buf = kalloc();
+  for(i = 0; i < sdSize(child); i++){
+    sd = SD(child, i);
+    if(!sd->inSF)
+      continue;
+    if(buf == 0 || (slot = swapalloc()) < 0)
+      break;
+    swapread(sd->slot, buf);
+    swapwrite(slot, buf);
+    sd->slot = slot;
+  }
+  if(buf)
+    kfree(buf);
+  if(i == sdSize(child))
+    return 0;
+  for(; i < sdSize(child); i++){
+    sd = SD(child, i);
+    sd->inSF = 0;
+    sd->loaded = 0;
+    sdFree(child, i);
+  }
+  return -1;
+}
+
+// A resident page advised MADV_SEQUENTIAL that the scan has left
+// behind (below the last such page faulted in), the farthest behind
+// first, or -1.  Every policy takes these before its own choice.
+static int
+sequentialVictim(struct proc *p){
+  int i, ans = -1;
+  pte_t *pte;
+
+  if(p->seqva == 0)
+    return -1;
+  for(i = 0; i < pdSize(p); i++){
+    if(!PD(p, i)->inMem || PD(p, i)->adv != MADV_SEQUENTIAL || (char*)PD(p, i)->va >= p->seqva)
+      continue;
+    pte = PD(p, i)->pte;
+    if(!(*pte & PTE_U))
+      continue;
+    if(ans < 0 || PD(p, i)->va < PD(p, ans)->va)
+      ans = i;
+  }
+  return ans;
+}
 
+// Returns the index of the page to to be removed: one the scan has
+// passed in a MADV_SEQUENTIAL range, or the choice of p's policy.
+int
+pageSelector(struct proc *p){
+  int ans;
 
-  if((ans < 0)||ans >= MAX_PSYC_PAGES){
+  if((ans = sequentialVictim(p)) < 0)
+    ans = p->policy->victim(p);
+  if((ans < 0)||ans >= pdSize(p) || !PD(p, ans)->inMem){
     panic("error - pageSelector end function - page limit violation");
   }
   return ans;
@@ -582,45 +1403,15 @@ pageSelector(struct proc *p){
 //page from the struct, and update the relevnt vars in the process struct
 void
 removePageAndUpdate(void *va,struct proc *p){
-  int i;   
-  //Case for NFUA/LAPA/SCFIFO
-   #ifndef AQ
-    for(i = 0; i < MAX_PSYC_PAGES; i++)
-      if(p->pd[i].va == va)
-        break;
-    if(i == MAX_PSYC_PAGES)
-      return;
-    if (p->pd[i].inMem == 1){
-      p->pd[i].inMem = 0;
-      p->pd[i].va = 0;
-      p->pim--;
-    }
-  #endif  
+  int i;
 
+  if((i = pdLookup(p, va)) < 0)
+    return;
+  if(PD(p, i)->sdi >= 0)
+    dropSwapCopy(p, i);
+  p->policy->remove(p, i);
+}
 
-  #ifdef AQ
-    for(i = 0 ; i < MAX_PSYC_PAGES ; i++){
-      if(p->pd[i].va == va){
-        break;
-      }
-    }
-    if (i >= p->pim)
-        panic("removePageAndUpdate function - index is illegal");
-    while(i < p->pim - 1){
-      p->pd[i].va = p->pd[i+1].va;
-      p->pd[i].page = p->pd[i+1].page;
-      if (p->pd[i].inMem == 0 || p->pd[i+1].inMem == 0)
-          panic("error - page not in memory");
-      i++;
-    } 
-    //Remove the last page in the memory
-    if (p->pd[p->pim - 1].inMem){
-      p->pd[p->pim - 1].inMem = 0;
-      p->pd[p->pim - 1].va = 0;
-      p->pim--;
-    } else panic("error - page not in memory");
-  #endif
-  }
 
   /*
     #ifdef NFUA
@@ -697,64 +1488,302 @@ removePageAndUpdate(void *va,struct proc *p){
 }
 */
 //The function will update the pages after read and at the allocuvm
-void
+//and return the page details index
+int
 updatePages(void *va,void *page,struct proc *p){
   int i;
-  for(i = 0; i < MAX_PSYC_PAGES; i++){
-    if(p->pd[i].inMem == 0){
-      break;
-    }
-  }
-  if(i == MAX_PSYC_PAGES){
+  if((i = pdAlloc(p)) < 0){
     panic("function updatePages - memory is full");
   }
-
-  //NFUA
-  #ifdef NFUA
-    p->pd[i].accCount = 0;
+  PD(p, i)->inMem = 1;
+  PD(p, i)->va = va;
+  PD(p, i)->pte = walkpgdir2(p->pgdir, va);
+  PD(p, i)->page = page;
+  PD(p, i)->sdi = -1;
+  PD(p, i)->ra = 0;
+  PD(p, i)->list = 0;
+  PD(p, i)->adv = (uint)va >= p->advstart && (uint)va < p->advend ? p->advice : MADV_NORMAL;
+  if(PD(p, i)->adv == MADV_SEQUENTIAL)
+    p->seqva = va;
+  pdHashInsert(p, i);
+  p->pim++;
+  p->policy->insert(p, i);
+  #ifdef GCLOCK
+  kframeset(page, p, va);
+  #endif
+  #ifndef NONE
+  if(p->maxpim - p->pim < KSWAPD_LOW || kfreeframes() < KSWAPD_LOW)
+    kswapdWake();
   #endif
+  return i;
+}
 
-  //LAPA
-  #ifdef LAPA
-    p->pd[i].accCount = 0xffffffff;
+//The function will point the page details of va at a new frame,
+//after copy-on-write gave the process a private copy
+void
+replacePage(void *va,void *page,struct proc *p){
+  int i;
+  if((i = pdLookup(p, va)) >= 0)
+    PD(p, i)->page = page;
+  #ifdef GCLOCK
+  kframeset(page, p, va);
   #endif
-  p->pd[i].inMem = 1;
-  p->pd[i].va = va;
-  p->pd[i].page = page;
-  p->pim++;
 }
 
+//The function will exchange page details i and j, keeping the va hash in step
+//(used by AQ, where the page details order is the queue order)
 void
-swapAndRead(void *va,struct proc *p){
+exchangePages(struct proc *p, int i, int j){
+  struct pDet pd;
+  pdHashRemove(p, i);
+  pdHashRemove(p, j);
+  pd.va = PD(p, i)->va;
+  pd.pte = PD(p, i)->pte;
+  pd.page = PD(p, i)->page;
+  PD(p, i)->va = PD(p, j)->va;
+  PD(p, i)->pte = PD(p, j)->pte;
+  PD(p, i)->page = PD(p, j)->page;
+  PD(p, j)->va = pd.va;
+  PD(p, j)->pte = pd.pte;
+  PD(p, j)->page = pd.page;
+  pd.sdi = PD(p, i)->sdi;
+  PD(p, i)->sdi = PD(p, j)->sdi;
+  PD(p, j)->sdi = pd.sdi;
+  pd.ra = PD(p, i)->ra;
+  PD(p, i)->ra = PD(p, j)->ra;
+  PD(p, j)->ra = pd.ra;
+  pd.adv = PD(p, i)->adv;
+  PD(p, i)->adv = PD(p, j)->adv;
+  PD(p, j)->adv = pd.adv;
+  pd.list = PD(p, i)->list;
+  PD(p, i)->list = PD(p, j)->list;
+  PD(p, j)->list = pd.list;
+  pd.accCount = PD(p, i)->accCount;
+  PD(p, i)->accCount = PD(p, j)->accCount;
+  PD(p, j)->accCount = pd.accCount;
+  pdHashInsert(p, i);
+  pdHashInsert(p, j);
+}
+
+//The function will map the frame newPage, just read from the swap
+//slot of va (whose PTE is pte), and return its page details index
+static int
+swappedIn(void *va, pte_t *pte, char *newPage, struct proc *p){
   struct sDet* sd;
+  int i, index;
+  sd = sdLookup(p, *pte, va);
+  index = SDINDEX(*pte);
+  pgtraceLog(p->pid, (uint)va, PGT_SWAPIN);
+  *pte = V2P(newPage) | PTE_P | (PTE_FLAGS(*pte) & ~PTE_PG);   // as swapOut() kept them
+  // Keep the slot: while PTE_D stays clear it is a clean copy.
+  sd->loaded = 1;
+  sd->susp = 0;
+  i = updatePages(va, newPage, p);
+  PD(p, i)->sdi = index;
+  if((PD(p, i)->adv = sd->adv) == MADV_SEQUENTIAL)
+    p->seqva = va;
+  p->sp--;
+  return i;
+}
+
+//The function will serve a fault on swapped out page va, telling the
+//policy if it evicted the page lately
+void
+swapAndRead(void *va,struct proc *p){
+  struct sDet *sd;
+  uint dist;
   int i;
-  cprintf("the VA is:%d \n",va);
-  for(sd = p->sd,i = 0; sd < &p->sd[MAX_PSYC_PAGES] ; sd++,i++){
-      cprintf("the sd->VA is:%d \n",sd->va);
-    if(sd->inSF && sd->va == va){
-      break;
-    }
-  }
-  if(sd >= &p->sd[MAX_PSYC_PAGES]){
-    panic("error - swapAndRead function -sd MAX");
-  }
-  pte_t* pte = walkpgdir(p->pgdir, va, 1);
-  if(!*pte){
+  pte_t* pte = walkpgdir(p->pgdir, va, 0);
+  if(!pte || !(*pte & PTE_PG)){
     panic("error - swapAndRead function - Not pte");
   }
   char* newPage = kalloc();
-  uint location = i * PGSIZE;
-  int qPGSIZE = PGSIZE/4;
-  for(i = 0 ; i < 4 ; i++){
-    readFromSwapFile(p, newPage + (i * qPGSIZE), location + (i * qPGSIZE), qPGSIZE);
+  if(newPage == 0)
+    panic("error - swapAndRead function - out of memory");
+  sd = sdLookup(p, *pte, va);
+  swapread(sd->slot, newPage);
+  i = swappedIn(va, pte, newPage, p);
+  if(sd->ghost){
+    dist = p->evicts - sd->ghost;
+    if(dist < p->maxpim)
+      p->gh++;
+    if(p->policy->refault)
+      p->policy->refault(p, i, sd->glist, dist);
+    sd->ghost = 0;
   }
-  *pte = (V2P(newPage) | PTE_P | PTE_U | PTE_W) & ~PTE_PG;
-  sd->inSF = 0;
-  updatePages(va, newPage, p);
-  p->sp--;
   lcr3(V2P(p->pgdir));
 }
 
+//Swap readahead, after swapAndRead served the fault at va.  A fault
+//one stride past the previous one also swaps in the next rawin pages
+//along that stride, into frames the process has to spare (at once if
+//the page is advised MADV_SEQUENTIAL, never if MADV_RANDOM).  A fault
+//just past the pages read ahead means they were all used, and doubles
+//the window; a page evicted before it was used halves it (swapAndWrite).
+//The pages of a burst are read with their requests in flight together.
+void
+readAhead(void *va, struct proc *p){
+  int n, i, got;
+  char *a;
+  char *vas[READAHEAD_MAX], *pages[READAHEAD_MAX];
+  uint slots[READAHEAD_MAX];
+  pte_t *pte;
+  char *seqva = p->seqva;
+  int stride;
+
+  if((i = pdLookup(p, va)) >= 0 && PD(p, i)->adv == MADV_RANDOM){
+    p->rawin = 0;
+    p->ralast = va;
+    return;
+  }
+  if(i >= 0 && PD(p, i)->adv == MADV_SEQUENTIAL && !(p->rawin > 0 && va == p->ranext)){
+    // Advised sequential: read ahead from the first fault on.
+    p->ralast = (char*)va - PGSIZE;
+    p->rastride = PGSIZE;
+    if(p->rawin == 0)
+      p->rawin = READAHEAD_MAX / 2;
+  }
+  stride = (char*)va - p->ralast;
+  if(p->rawin > 0 && va == p->ranext){
+    for(a = p->ralast + p->rastride; a != va; a += p->rastride)
+      if((i = pdLookup(p, a)) >= 0)
+        PD(p, i)->ra = 0;
+    p->rawin = p->rawin * 2 > READAHEAD_MAX ? READAHEAD_MAX : p->rawin * 2;
+  } else if(stride != 0 && stride == p->rastride){
+    if(p->rawin == 0)
+      p->rawin = 1;
+  } else {
+    p->rastride = stride;
+    p->rawin = 0;
+  }
+  p->ralast = va;
+  p->ranext = 0;
+
+  got = 0;
+  a = va;
+  for(n = 0; n < p->rawin; n++){
+    a += p->rastride;
+    if(((uint)a >= p->sz && vmaLookup(p, (uint)a) == 0) || p->pim + got >= p->maxpim)
+      break;
+    #ifdef GCLOCK
+    if(kfreeframes() - got <= GCLOCK_LOW)
+      break;
+    #endif
+    pte = walkpgdir(p->pgdir, a, 0);
+    if(pte == 0 || !(*pte & PTE_PG))
+      continue;
+    if((pages[got] = kalloc()) == 0)
+      break;
+    vas[got] = a;
+    slots[got] = sdLookup(p, *pte, a)->slot;
+    got++;
+  }
+  if(got == 0)
+    return;
+  if(n == p->rawin)
+    a += p->rastride;
+  p->ranext = a;
+
+  swapreadv(slots, pages, got);
+  for(n = 0; n < got; n++){
+    i = swappedIn(vas[n], walkpgdir(p->pgdir, vas[n], 0), pages[n], p);
+    PD(p, i)->ra = 1;
+    p->ra++;
+  }
+  p->seqva = seqva;     // the scan has not got there yet
+  lcr3(V2P(p->pgdir));
+}
+
+//Record madvise() advice for the pages of p in [a, b): in the page
+//details of resident pages, the swap details of swapped out ones, and
+//for pages mapped later, in the process (one range, the last advised).
+//Called with the paging lock held.
+void
+adviseRange(struct proc *p, uint a, uint b, int advice){
+  uint va;
+  pte_t *pte;
+  int i;
+
+  for(va = a; va < b; va += PGSIZE){
+    if((i = pdLookup(p, (void*)va)) >= 0)
+      PD(p, i)->adv = advice;
+    else if((pte = walkpgdir2(p->pgdir, (void*)va)) && (*pte & PTE_PG))
+      sdLookup(p, *pte, (void*)va)->adv = advice;
+  }
+  p->advstart = a;
+  p->advend = b;
+  p->advice = advice;
+}
+
+//MADV_WILLNEED: bring the swapped out pages of p in [a, b) back, as
+//far as p has resident slots to spare, in bursts whose reads are in
+//flight together.  Called with the paging lock held.
+void
+prefetchRange(struct proc *p, uint a, uint b){
+  char *vas[READAHEAD_MAX], *pages[READAHEAD_MAX];
+  uint slots[READAHEAD_MAX];
+  char *seqva = p->seqva;
+  pte_t *pte;
+  uint va = a;
+  int n, i;
+
+  do {
+    for(n = 0; va < b && n < READAHEAD_MAX && p->pim + n < p->maxpim; va += PGSIZE){
+      pte = walkpgdir(p->pgdir, (void*)va, 0);
+      if(pte == 0 || !(*pte & PTE_PG))
+        continue;
+      #ifdef GCLOCK
+      if(kfreeframes() - n <= GCLOCK_LOW)
+        break;
+      #endif
+      if((pages[n] = kalloc()) == 0)
+        break;
+      vas[n] = (char*)va;
+      slots[n] = sdLookup(p, *pte, (char*)va)->slot;
+      n++;
+    }
+    if(n > 0)
+      swapreadv(slots, pages, n);
+    for(i = 0; i < n; i++)
+      swappedIn(vas[i], walkpgdir(p->pgdir, vas[i], 0), pages[i], p);
+  } while(n == READAHEAD_MAX);
+  p->seqva = seqva;
+  lcr3(V2P(p->pgdir));
+}
+
+//Bring back the pages swapOutAll() took from p when the load control
+//swapper suspended it, as far as p has resident slots to spare, in
+//bursts whose reads are in flight together.  Called with the paging
+//lock held; p must not be running.
+void
+swapInSuspended(struct proc *p){
+  char *vas[READAHEAD_MAX], *pages[READAHEAD_MAX];
+  uint slots[READAHEAD_MAX];
+  struct sDet *sd;
+  int n, i, s = 0;
+
+  do {
+    for(n = 0; s < sdSize(p) && n < READAHEAD_MAX && p->pim + n < p->maxpim; s++){
+      sd = SD(p, s);
+      if(!sd->inSF || sd->loaded || !sd->susp)
+        continue;
+      #ifdef GCLOCK
+      if(kfreeframes() - n <= GCLOCK_LOW)
+        break;
+      #endif
+      if((pages[n] = kalloc()) == 0)
+        break;
+      vas[n] = sd->va;
+      slots[n] = sd->slot;
+      n++;
+    }
+    if(n > 0)
+      swapreadv(slots, pages, n);
+    for(i = 0; i < n; i++)
+      swappedIn(vas[i], walkpgdir(p->pgdir, vas[i], 0), pages[i], p);
+  } while(n == READAHEAD_MAX);
+}
+
 
 
 //PAGEBREAK!
@@ -130,6 +130,24 @@ xchg(volatile uint *addr, uint newval)
   return result;
 }
 
+// Index of the lowest set bit of v, which must not be zero.
+static inline uint
+bsf(uint v)
+{
+  uint r;
+  asm volatile("bsfl %1,%0" : "=r" (r) : "rm" (v) : "cc");
+  return r;
+}
+
+// CPU cycle counter.
+static inline unsigned long long
+rdtsc(void)
+{
+  unsigned long long t;
+  asm volatile("rdtsc" : "=A" (t));
+  return t;
+}
+
 static inline uint
 rcr2(void)
 {